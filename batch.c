@@ -0,0 +1,97 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "game.h"
+#include "tool.h"
+#include "global.h"
+
+// Headless batch runner: steps many independent worlds across all cores
+// usage: batch [worlds] [steps per world] [threads]
+
+// Typedefs
+typedef struct BatchJob {
+  int first, stride, worlds;
+  long steps;
+  // Results
+  long totalSteps;
+  long strips;
+  long carves;
+  long stuckSteps; // Steps that ended with the player's cell solid
+} BatchJob;
+
+// Local function definitions
+static void *runJob(void *arg);
+
+int main(int argc, char **argv) {
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1) threads = 1;
+  int worlds = argc > 1 ? atoi(argv[1]) : threads * 4;
+  long steps = argc > 2 ? atol(argv[2]) : 1000000;
+  if (argc > 3) threads = atoi(argv[3]);
+  if (threads > worlds) threads = worlds;
+  if (worlds < 1 || steps < 1 || threads < 1) {
+    fprintf(stderr, "usage: %s [worlds] [steps per world] [threads]\n", argv[0]);
+    return 1;
+  }
+
+  BatchJob *jobs = calloc(threads, sizeof(BatchJob));
+  pthread_t *handles = malloc(threads * sizeof(pthread_t));
+
+  double startTime = now();
+  for (int i = 0; i < threads; i++) {
+    jobs[i] = (BatchJob){.first = i, .stride = threads, .worlds = worlds, .steps = steps};
+    pthread_create(&handles[i], NULL, runJob, &jobs[i]);
+  }
+
+  BatchJob total = {0};
+  for (int i = 0; i < threads; i++) {
+    pthread_join(handles[i], NULL);
+    total.totalSteps += jobs[i].totalSteps;
+    total.strips += jobs[i].strips;
+    total.carves += jobs[i].carves;
+    total.stuckSteps += jobs[i].stuckSteps;
+  }
+  double elapsed = now() - startTime;
+
+  printf("worlds: %d\nthreads: %d\nsteps: %ld\ntime: %fs\n", worlds, threads, total.totalSteps, elapsed);
+  printf("steps/s: %.0f\nsteps/s per thread: %.0f\n", total.totalSteps / elapsed, total.totalSteps / elapsed / threads);
+  printf("strips: %ld\ncarved cells per strip: %f\nsteps inside a wall: %ld\n", total.strips, total.strips ? total.carves / (double)total.strips : 0.0, total.stuckSteps);
+
+  free(handles);
+  free(jobs);
+  return 0;
+}
+
+static void *runJob(void *arg) {
+  BatchJob *job = arg;
+  GameState game;
+
+  for (int w = job->first; w < job->worlds; w += job->stride) {
+    initWorld(&game, 0x9e3779b9u * (w + 1));
+
+    // Wander in a random direction, changing every couple of seconds
+    uint dirSeed = w * 2654435761u + 1;
+    Vector2 rawIn = Vector2Zero();
+    long stuckSteps = 0; // Counted locally, jobs sit next to each other in one allocation
+    for (long i = 0; i < job->steps; i++) {
+      if (i % 97 == 0) {
+        dirSeed ^= dirSeed << 13;
+        dirSeed ^= dirSeed >> 17;
+        dirSeed ^= dirSeed << 5;
+        rawIn = (Vector2){(int)(dirSeed % 3) - 1, (int)(dirSeed / 3 % 3) - 1};
+      }
+      stepGame(&game, rawIn, 1 / 60.0f);
+      if (getRegion(&game, game.gridPos) < 0) stuckSteps++;
+    }
+
+    job->totalSteps += job->steps;
+    job->strips += game.stripCount;
+    job->carves += game.carveCount;
+    job->stuckSteps += stuckSteps;
+  }
+  return NULL;
+}
@@ -1,6 +1,28 @@
 #! /bin/bash
 set -e
-cc -g -std=c99 -c main.c -o obj/main.o
-cc -g -std=c99 -c game.c -o obj/game.o
-cc -o build/main obj/main.o obj/game.o -s -Wall -std=c99 -lraylib -lm -lpthread -ldl -lrt
+# World configuration, e.g. VIEW_RADIUS=16 TILE_SIZE=24 ./build.sh
+CFLAGS="-g -O2 -std=c99 -DVIEW_RADIUS=${VIEW_RADIUS:-10} -DTILE_SIZE=${TILE_SIZE:-32}"
+cc $CFLAGS -c main.c -o obj/main.o
+cc $CFLAGS -c game.c -o obj/game.o
+cc $CFLAGS -c render.c -o obj/render.o
+cc $CFLAGS -c particles.c -o obj/particles.o
+cc $CFLAGS -c replay.c -o obj/replay.o
+cc $CFLAGS -c store.c -o obj/store.o
+cc $CFLAGS -c tool.c -o obj/tool.o
+cc $CFLAGS -c batch.c -o obj/batch.o
+cc $CFLAGS -c reachcheck.c -o obj/reachcheck.o
+cc $CFLAGS -c playback.c -o obj/playback.o
+cc $CFLAGS -c net.c -o obj/net.o
+cc $CFLAGS -c server.c -o obj/server.o
+cc $CFLAGS -c netbench.c -o obj/netbench.o
+cc $CFLAGS -c frames.c -o obj/frames.o
+cc $CFLAGS -c particlebench.c -o obj/particlebench.o
+cc -o build/main obj/main.o obj/game.o obj/render.o obj/particles.o obj/store.o obj/replay.o obj/net.o -s -Wall -std=c99 -lraylib -lm -lpthread -ldl -lrt
+cc -o build/batch obj/batch.o obj/tool.o obj/game.o obj/render.o obj/store.o -s -Wall -std=c99 -lraylib -lm -lpthread -ldl -lrt
+cc -o build/reachcheck obj/reachcheck.o obj/tool.o obj/game.o obj/render.o obj/store.o -s -Wall -std=c99 -lraylib -lm -lpthread -ldl -lrt
+cc -o build/playback obj/playback.o obj/tool.o obj/game.o obj/render.o obj/store.o obj/replay.o -s -Wall -std=c99 -lraylib -lm -lpthread -ldl -lrt
+cc -o build/server obj/server.o obj/tool.o obj/net.o obj/game.o obj/render.o obj/store.o -s -Wall -std=c99 -lraylib -lm -lpthread -ldl -lrt
+cc -o build/netbench obj/netbench.o obj/tool.o obj/net.o obj/game.o obj/render.o obj/store.o -s -Wall -std=c99 -lraylib -lm -lpthread -ldl -lrt
+cc -o build/frames obj/frames.o obj/tool.o obj/game.o obj/render.o obj/store.o -s -Wall -std=c99 -lraylib -lm -lpthread -ldl -lrt
+cc -o build/particlebench obj/particlebench.o obj/tool.o obj/particles.o obj/game.o obj/render.o obj/store.o -s -Wall -std=c99 -lraylib -lm -lpthread -ldl -lrt
 ./build/main
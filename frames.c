@@ -0,0 +1,83 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "game.h"
+#include "render.h"
+#include "tool.h"
+#include "global.h"
+
+// Headless rendering: simulates a scripted walk through a fixed world and rasterizes every frame on the CPU.
+// Every 60th frame is written to, or checked against, golden PNGs in dir
+// usage: frames [frames] [threads] [dir] [--write]
+// Goldens for the default build are in goldens/, check with ./build/frames 300 4 goldens and rewrite them with
+// --write only after a change meant to alter the picture
+
+// Variables
+static GameState game;
+static Renderer renderer;
+
+int main(int argc, char **argv) {
+  int frames = argc > 1 ? atoi(argv[1]) : 600;
+  int threads = argc > 2 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+  const char *dir = argc > 3 ? argv[3] : NULL;
+  bool write = argc > 4 && strcmp(argv[4], "--write") == 0;
+  if (frames < 1 || threads < 1) {
+    fprintf(stderr, "usage: %s [frames] [threads] [dir] [--write]\n", argv[0]);
+    return 1;
+  }
+
+  initRenderer(&renderer, RENDER_SOFTWARE, NULL, threads);
+  // Same world and the same flicker every run so frames can be compared
+  initGame(&game, &renderer, 1);
+
+  double totalT = 0, slowestT = 0;
+  int checked = 0, mismatched = 0;
+  for (int frame = 1; frame <= frames; frame++) {
+    stepGame(&game, unpackInput((frame / 90) % 16), 1.0f / 60.0f);
+
+    double startTime = now();
+    drawGame(&game, &renderer);
+    double frameT = now() - startTime;
+    totalT += frameT;
+    if (frameT > slowestT) slowestT = frameT;
+
+    if (dir == NULL || frame % 60 != 0) continue;
+    char fileName[1024];
+    snprintf(fileName, sizeof(fileName), "%s/frame%04d.png", dir, frame);
+    if (write) {
+      if (!ExportImage(frameImage(&renderer), fileName)) fprintf(stderr, "could not write %s\n", fileName);
+      continue;
+    }
+
+    checked++;
+    Image golden = LoadImage(fileName);
+    if (golden.data == NULL) {
+      fprintf(stderr, "missing %s\n", fileName);
+      mismatched++;
+      continue;
+    }
+    ImageFormat(&golden, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    int differing = 0;
+    if (golden.width != viewportWidth || golden.height != viewportHeight) differing = viewportWidth * viewportHeight;
+    else {
+      const Color *expected = golden.data;
+      for (int i = 0; i < viewportWidth * viewportHeight; i++) differing += memcmp(&expected[i], &renderer.pixels[i], sizeof(Color)) != 0;
+    }
+    if (differing) {
+      printf("%s: %d pixels differ\n", fileName, differing);
+      mismatched++;
+    }
+    UnloadImage(golden);
+  }
+
+  printf("%d frames on %d threads: %.0fus average, %.0fus slowest\n", frames, threads, totalT / frames * 1000000, slowestT * 1000000);
+  if (dir != NULL && !write) printf("%d of %d golden frames match\n", checked - mismatched, checked);
+
+  unloadGame(&game);
+  unloadRenderer(&renderer);
+  return mismatched ? 1 : 0;
+}
@@ -5,16 +5,31 @@
 #include "raylib.h"
 #include "raymath.h"
 #include "game.h"
+#include "store.h"
+#include "render.h"
 #include "global.h"
 
 // Local function definitions
 static Quad rectToQuad(Rectangle rect);
 static float rectPointDist(Vector2 point, Rectangle rect);
 static Int2 indexShit(uint x);
-static bool readFromLevel(Int2 pos);
-static void writeToLevel(Int2 pos, bool state);
-static void drawTile(Vector2 pos);
+static bool readFromLevel(GameState *game, Int2 pos);
+static void writeToLevel(GameState *game, Int2 pos, bool state);
+static bool restoreCell(GameState *game, Int2 pos);
+static void drawTile(GameState *game, Renderer *renderer, Vector2 pos);
+static Image genVignette(int width, int height);
 static uint myMod(int a, int b);
+static int randomValue(uint *rng, int min, int max);
+static int reachFind(GameState *game, int label);
+static void reachUnion(GameState *game, int a, int b);
+static bool reachInWindow(GameState *game, Int2 pos);
+static void reachLink(GameState *game, Int2 pos);
+static void reachRebuild(GameState *game, Int2 centre);
+static bool reachSplit(GameState *game, Int2 start, Int2 step, Int2 inward);
+static bool reachPending(short *parent, const short *line, const short *region, int runs, short *seen, int stamp);
+static int runFind(short *parent, int run);
+static void trackStrip(GameState *game, Int2 centre, Int2 start, Int2 step, Int2 inward);
+static void openStrip(GameState *game, Int2 start, Int2 step, Int2 inward);
 
 // Constants
 const Vector2 screenCentre = (Vector2){viewportWidth / 2.0f, viewportHeight / 2.0f};
@@ -22,67 +37,176 @@ const struct {
   float speed;
   float size;
 } playerConsts = {80, 6};
+// First ring of the indexShit() spiral, the cells collisions check
+static const Int2 neighbours[8] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}, {-1, -1}, {1, -1}, {-1, 1}, {1, 1}};
 
 // Variables
-static PlayerData player = {(Vector2){0, 0}};
-static bool paused = false;
-static WorldData world;
-//static Camera2D camera;
-static Vector2 globalOffset;
-static Int2 gridPos;
-static Vector2 viewportPos;
+static Int2 spiral[VIEW_CELLS]; // indexShit() over the whole view, only drawing uses it so initGame() fills it
 
-static Texture2D backgroundTex;
-static Texture2D vignetteTex;
+void initGame(GameState *game, Renderer *renderer, uint seed) {
 
-static float flicker = 0;
+  //camera = (Camera2D){Vector2Zero(), Vector2Zero(), 0.0f, 1.0f};
 
-void initGame() {
+  initWorld(game, seed);
+  for (uint i = 1; i < VIEW_CELLS; i++) spiral[i] = indexShit(i);
 
-  //camera = (Camera2D){Vector2Zero(), Vector2Zero(), 0.0f, 1.0f};
+  Image img = GenImageChecked(TILE_SIZE * 2, TILE_SIZE * 2, TILE_SIZE, TILE_SIZE, (Color){30, 30, 30, 255}, (Color){15, 15, 15, 255});
+  game->backgroundTex = loadRenderImage(renderer, img);
 
-  Image img = GenImageChecked(64, 64, 32, 32, (Color){30, 30, 30, 255}, (Color){15, 15, 15, 255});
-  backgroundTex = LoadTextureFromImage(img);
-  UnloadImage(img);
+  img = genVignette(viewportWidth, viewportHeight);
+  game->vignetteTex = loadRenderImage(renderer, img);
+}
 
-  img = GenImageGradientRadial(viewportWidth, viewportHeight, 0.1f, (Color){0, 0, 0, 0}, (Color){0, 0, 0, 255});
-  vignetteTex = LoadTextureFromImage(img);
-  UnloadImage(img);
+// Resets the simulation only, safe to call without a window for headless worlds
+void initWorld(GameState *game, uint seed) {
+  *game = (GameState){0};
+  game->rng = seed ? seed : 1;
+  game->moveRng = game->rng * 2654435761u | 1;
+  game->flickerRng = game->rng * 0x85ebca6bu | 1;
+  reachRebuild(game, game->gridPos);
 }
 
-void updateGame(float delta) {
-  if (paused) delta *= 0.01;
+// Resumes from the store's saved player if it has one, otherwise starts persisting the current window
+void attachStore(GameState *game, WorldStore *store) {
+  game->store = store;
+  if (store->header.hasPlayer) {
+    game->rng = store->header.rng ? store->header.rng : 1;
+    game->rawPos = (Vector2){store->header.playerX, store->header.playerY};
+    settlePlayer(game);
+  }
+
+  for (int y = -VIEW_RADIUS; y <= VIEW_RADIUS; y++) {
+    for (int x = -VIEW_RADIUS; x <= VIEW_RADIUS; x++) {
+      Int2 pos = (Int2){game->gridPos.x + x, game->gridPos.y + y};
+      if (!restoreCell(game, pos)) writeToLevel(game, pos, readFromLevel(game, pos));
+    }
+  }
+  reachRebuild(game, game->gridPos);
+}
 
+// Raw movement direction from the keyboard, each component -1, 0 or 1
+Vector2 readInput() {
   Vector2 rawIn = Vector2Zero();
-  static Vector2 rawPos = (Vector2){0, 0};
 
   if (IsKeyDown(KEY_W) || IsKeyDown(KEY_UP)) rawIn.y--;
   if (IsKeyDown(KEY_S) || IsKeyDown(KEY_DOWN)) rawIn.y++;
   if (IsKeyDown(KEY_A) || IsKeyDown(KEY_LEFT)) rawIn.x--;
   if (IsKeyDown(KEY_D) || IsKeyDown(KEY_RIGHT)) rawIn.x++;
 
-  rawIn = Vector2Scale(Vector2Normalize(rawIn), playerConsts.speed * delta * GetRandomValue(30, 100) / 100.0f);
-  rawPos = Vector2Add(rawPos, rawIn);
-  Int2 oldGridPos = gridPos;
-  gridPos = (Int2){(roundf(rawPos.x) > 0 ? (int)roundf(rawPos.x) / 32 : floor(roundf(rawPos.x) / 32.0f)), (roundf(rawPos.y) > 0 ? (int)roundf(rawPos.y) / 32 : floor(roundf(rawPos.y) / 32.0f))};
+  return rawIn;
+}
+
+// Four key bits (up, down, left, right) for a raw input direction, as stored in replays and input packets
+uint packInput(Vector2 rawIn) {
+  return (rawIn.y < 0) | (rawIn.y > 0) << 1 | (rawIn.x < 0) << 2 | (rawIn.x > 0) << 3;
+}
+
+Vector2 unpackInput(uint keys) {
+  return (Vector2){(int)(keys >> 3 & 1) - (int)(keys >> 2 & 1), (int)(keys >> 1 & 1) - (int)(keys & 1)};
+}
+
+// One simulation tick from a raw input direction, touches nothing outside game
+void stepGame(GameState *game, Vector2 rawIn, float delta) {
+  Int2 oldGridPos = game->gridPos;
+  movePlayer(game, rawIn, delta);
+
+  // Level gen, from the settled position so a cell crossed by a collision push still gets its strip
+  if (game->gridPos.x > oldGridPos.x) {
+    int stripPos = game->gridPos.x + VIEW_RADIUS;
+    for (int i = 0; i < VIEW_SIZE; i++) {
+      Int2 pos = (Int2){stripPos, game->reach.centre.y - VIEW_RADIUS + i};
+      if (restoreCell(game, pos)) continue;
+      if (readFromLevel(game, (Int2){pos.x-1, pos.y-1})) {
+        writeToLevel(game, pos, 0);
+      } else if (readFromLevel(game, (Int2){pos.x, pos.y-1}) && readFromLevel(game, (Int2){pos.x-1, pos.y})) {
+        writeToLevel(game, pos, 1);
+      } else {
+        writeToLevel(game, pos, randomValue(&game->rng, 0, 1));
+      }
+    }
+    trackStrip(game, (Int2){game->gridPos.x, game->reach.centre.y}, (Int2){stripPos, game->reach.centre.y - VIEW_RADIUS}, (Int2){0, 1}, (Int2){-1, 0});
+  } else if (game->gridPos.x < oldGridPos.x) {
+    int stripPos = game->gridPos.x - VIEW_RADIUS;
+    for (int i = 0; i < VIEW_SIZE; i++) {
+      Int2 pos = (Int2){stripPos, game->reach.centre.y - VIEW_RADIUS + i};
+      if (restoreCell(game, pos)) continue;
+      if (readFromLevel(game, (Int2){pos.x+1, pos.y-1})) {
+        writeToLevel(game, pos, 0);
+      } else if (readFromLevel(game, (Int2){pos.x, pos.y-1}) && readFromLevel(game, (Int2){pos.x+1, pos.y})) {
+        writeToLevel(game, pos, 1);
+      } else {
+        writeToLevel(game, pos, randomValue(&game->rng, 0, 1));
+      }
+    }
+    trackStrip(game, (Int2){game->gridPos.x, game->reach.centre.y}, (Int2){stripPos, game->reach.centre.y - VIEW_RADIUS}, (Int2){0, 1}, (Int2){1, 0});
+  }
+  if (game->gridPos.y > oldGridPos.y) {
+    int stripPos = game->gridPos.y + VIEW_RADIUS;
+    for (int i = 0; i < VIEW_SIZE; i++) {
+      Int2 pos = (Int2){game->reach.centre.x - VIEW_RADIUS + i, stripPos};
+      if (restoreCell(game, pos)) continue;
+      if (readFromLevel(game, (Int2){pos.x-1, pos.y-1})) {
+        writeToLevel(game, pos, 0);
+      } else if (readFromLevel(game, (Int2){pos.x, pos.y-1}) && readFromLevel(game, (Int2){pos.x-1, pos.y})) {
+        writeToLevel(game, pos, 1);
+      } else {
+        writeToLevel(game, pos, randomValue(&game->rng, 0, 1));
+      }
+    }
+    trackStrip(game, (Int2){game->reach.centre.x, game->gridPos.y}, (Int2){game->reach.centre.x - VIEW_RADIUS, stripPos}, (Int2){1, 0}, (Int2){0, -1});
+  } else if (game->gridPos.y < oldGridPos.y) {
+    int stripPos = game->gridPos.y - VIEW_RADIUS;
+    for (int i = 0; i < VIEW_SIZE; i++) {
+      Int2 pos = (Int2){game->reach.centre.x - VIEW_RADIUS + i, stripPos};
+      if (restoreCell(game, pos)) continue;
+      if (readFromLevel(game, (Int2){pos.x-1, pos.y+1})) {
+        writeToLevel(game, pos, 0);
+      } else if (readFromLevel(game, (Int2){pos.x, pos.y+1}) && readFromLevel(game, (Int2){pos.x-1, pos.y})) {
+        writeToLevel(game, pos, 1);
+      } else {
+        writeToLevel(game, pos, randomValue(&game->rng, 0, 1));
+      }
+    }
+    trackStrip(game, (Int2){game->reach.centre.x, game->gridPos.y}, (Int2){game->reach.centre.x - VIEW_RADIUS, stripPos}, (Int2){1, 0}, (Int2){0, 1});
+  }
+
+  // Only once the window has slid both ways, so a strip is judged against the cell the player ended up in
+  if (game->gridPos.x != oldGridPos.x) {
+    int inward = game->gridPos.x > oldGridPos.x ? -1 : 1;
+    openStrip(game, (Int2){game->gridPos.x - inward * VIEW_RADIUS, game->reach.centre.y - VIEW_RADIUS}, (Int2){0, 1}, (Int2){inward, 0});
+  }
+  if (game->gridPos.y != oldGridPos.y) {
+    int inward = game->gridPos.y > oldGridPos.y ? -1 : 1;
+    openStrip(game, (Int2){game->reach.centre.x - VIEW_RADIUS, game->gridPos.y - inward * VIEW_RADIUS}, (Int2){1, 0}, (Int2){0, inward});
+  }
+}
+
+// Movement and collisions without any level generation, clients use it to predict their own player
+void movePlayer(GameState *game, Vector2 rawIn, float delta) {
+  if (game->paused) delta *= 0.01;
+
+  rawIn = Vector2Scale(Vector2Normalize(rawIn), playerConsts.speed * delta * randomValue(&game->moveRng, 30, 100) / 100.0f);
+  game->rawPos = Vector2Add(game->rawPos, rawIn);
+  game->gridPos = (Int2){(roundf(game->rawPos.x) > 0 ? (int)roundf(game->rawPos.x) / TILE_SIZE : floor(roundf(game->rawPos.x) / (float)TILE_SIZE)), (roundf(game->rawPos.y) > 0 ? (int)roundf(game->rawPos.y) / TILE_SIZE : floor(roundf(game->rawPos.y) / (float)TILE_SIZE))};
 
   // Collisions
+  Vector2 unpushed = game->rawPos;
   for (int i = 0; i < 8; i++) {
-    Int2 relPos = indexShit(i+1);
-    if (readFromLevel((Int2){gridPos.x + relPos.x, gridPos.y + relPos.y})) {
-      Rectangle rect = (Rectangle){(gridPos.x + relPos.x) * 32, (gridPos.y + relPos.y) * 32, 32, 32};
-
-      if (rect.y + rect.height > rawPos.y && rawPos.y > rect.y) {
-        if (rawPos.x > rect.x + rect.width && rawPos.x < rect.x + rect.width + playerConsts.size) {
-          rawPos.x -= rawPos.x - (rect.x + rect.width + playerConsts.size);
-        } else if (rawPos.x < rect.x && rawPos.x > rect.x - playerConsts.size) {
-          rawPos.x -= rawPos.x - (rect.x - playerConsts.size);
+    Int2 relPos = neighbours[i];
+    if (readFromLevel(game, (Int2){game->gridPos.x + relPos.x, game->gridPos.y + relPos.y})) {
+      Rectangle rect = (Rectangle){(game->gridPos.x + relPos.x) * TILE_SIZE, (game->gridPos.y + relPos.y) * TILE_SIZE, TILE_SIZE, TILE_SIZE};
+
+      if (rect.y + rect.height > game->rawPos.y && game->rawPos.y > rect.y) {
+        if (game->rawPos.x > rect.x + rect.width && game->rawPos.x < rect.x + rect.width + playerConsts.size) {
+          game->rawPos.x -= game->rawPos.x - (rect.x + rect.width + playerConsts.size);
+        } else if (game->rawPos.x < rect.x && game->rawPos.x > rect.x - playerConsts.size) {
+          game->rawPos.x -= game->rawPos.x - (rect.x - playerConsts.size);
         }
-      } else if (rect.x + rect.width > rawPos.x && rawPos.x > rect.x) {
-        if (rawPos.y > rect.y + rect.height && rawPos.y < rect.y + rect.height + playerConsts.size) {
-          rawPos.y -= rawPos.y - (rect.y + rect.height + playerConsts.size);
-        } else if (rawPos.y < rect.y && rawPos.y > rect.y - playerConsts.size) {
-          rawPos.y -= rawPos.y - (rect.y - playerConsts.size);
+      } else if (rect.x + rect.width > game->rawPos.x && game->rawPos.x > rect.x) {
+        if (game->rawPos.y > rect.y + rect.height && game->rawPos.y < rect.y + rect.height + playerConsts.size) {
+          game->rawPos.y -= game->rawPos.y - (rect.y + rect.height + playerConsts.size);
+        } else if (game->rawPos.y < rect.y && game->rawPos.y > rect.y - playerConsts.size) {
+          game->rawPos.y -= game->rawPos.y - (rect.y - playerConsts.size);
         }
       } else {
         Quad quad = rectToQuad(rect);
@@ -90,111 +214,96 @@ void updateGame(float delta) {
         float dist = FLT_MAX;
         int corner;
         for (int i = 0; i < 4; i++) {
-          float temp = Vector2Distance(rawPos, quad.verts[i]);
+          float temp = Vector2Distance(game->rawPos, quad.verts[i]);
           dist = fminf(dist, temp);
           if (temp == dist) corner = i;
         }
 
         if (dist < playerConsts.size) {
-          Vector2 change = Vector2Scale(Vector2Normalize(Vector2Subtract(rawPos, quad.verts[corner])), dist - playerConsts.size);
-          rawPos = Vector2Subtract(rawPos, change);
+          Vector2 change = Vector2Scale(Vector2Normalize(Vector2Subtract(game->rawPos, quad.verts[corner])), dist - playerConsts.size);
+          game->rawPos = Vector2Subtract(game->rawPos, change);
         }
       }
     }
   }
-
-  // Level gen
-  if (gridPos.x > oldGridPos.x) {
-    int stripPos = gridPos.x + 10;
-    for (int i = 0; i < 21; i++) {
-      Int2 pos = (Int2){stripPos, i};
-      if (readFromLevel((Int2){pos.x-1, pos.y-1})) {
-        writeToLevel(pos, 0);
-      } else if (readFromLevel((Int2){pos.x, pos.y-1}) && readFromLevel((Int2){pos.x-1, pos.y})) {
-        writeToLevel(pos, 1);
-      } else {
-        writeToLevel(pos, GetRandomValue(0, 1));
-      }
-    }
-  } else if (gridPos.x < oldGridPos.x) {
-    int stripPos = gridPos.x - 10;
-    for (int i = 0; i < 21; i++) {
-      Int2 pos = (Int2){stripPos, i};
-      if (readFromLevel((Int2){pos.x+1, pos.y-1})) {
-        writeToLevel(pos, 0);
-      } else if (readFromLevel((Int2){pos.x, pos.y-1}) && readFromLevel((Int2){pos.x+1, pos.y})) {
-        writeToLevel(pos, 1);
-      } else {
-        writeToLevel(pos, GetRandomValue(0, 1));
-      }
-    }
-  }
-  if (gridPos.y > oldGridPos.y) {
-    int stripPos = gridPos.y + 10;
-    for (int i = 0; i < 21; i++) {
-      Int2 pos = (Int2){i, stripPos};
-      if (readFromLevel((Int2){pos.x-1, pos.y-1})) {
-        writeToLevel(pos, 0);
-      } else if (readFromLevel((Int2){pos.x, pos.y-1}) && readFromLevel((Int2){pos.x-1, pos.y})) {
-        writeToLevel(pos, 1);
-      } else {
-        writeToLevel(pos, GetRandomValue(0, 1));
-      }
-    }
-  } else if (gridPos.y < oldGridPos.y) {
-    int stripPos = gridPos.y - 10;
-    for (int i = 0; i < 21; i++) {
-      Int2 pos = (Int2){i, stripPos};
-      if (readFromLevel((Int2){pos.x-1, pos.y+1})) {
-        writeToLevel(pos, 0);
-      } else if (readFromLevel((Int2){pos.x, pos.y+1}) && readFromLevel((Int2){pos.x-1, pos.y})) {
-        writeToLevel(pos, 1);
-      } else {
-        writeToLevel(pos, GetRandomValue(0, 1));
-      }
-    }
+  if (game->rawPos.x != unpushed.x || game->rawPos.y != unpushed.y) {
+    game->bumpCount++;
+    game->bumpNormal = Vector2Normalize(Vector2Subtract(game->rawPos, unpushed));
   }
 
-  player.pos = (Vector2){roundf(rawPos.x), roundf(rawPos.y)};
-  gridPos = (Int2){(player.pos.x > 0 ? (int)player.pos.x / 32 : floor(player.pos.x / 32.0f)), (player.pos.y > 0 ? (int)player.pos.y / 32 : floor(player.pos.y / 32.0f))};
-  globalOffset = Vector2Subtract(screenCentre, player.pos);
-  viewportPos = Vector2Subtract(player.pos, screenCentre);
+  settlePlayer(game);
 }
 
-void drawGame(RenderTexture2D *output) {
-  flicker += GetRandomValue(-150, 150) / 100.0f;
-  flicker = Clamp(flicker, 0, 64);
+// Derives the rounded position, grid cell and view offsets from rawPos
+void settlePlayer(GameState *game) {
+  game->player.pos = (Vector2){roundf(game->rawPos.x), roundf(game->rawPos.y)};
+  game->gridPos = (Int2){(game->player.pos.x > 0 ? (int)game->player.pos.x / TILE_SIZE : floor(game->player.pos.x / (float)TILE_SIZE)), (game->player.pos.y > 0 ? (int)game->player.pos.y / TILE_SIZE : floor(game->player.pos.y / (float)TILE_SIZE))};
+  game->globalOffset = Vector2Subtract(screenCentre, game->player.pos);
+  game->viewportPos = Vector2Subtract(game->player.pos, screenCentre);
+}
+
+// Relabels the window around the player from scratch, for when world and rawPos were restored from elsewhere
+void rebuildReach(GameState *game) {
+  reachRebuild(game, game->gridPos);
+}
+
+void drawGame(GameState *game, Renderer *renderer) {
+  game->flicker += randomValue(&game->flickerRng, -150, 150) / 100.0f;
+  game->flicker = Clamp(game->flicker, 0, 64);
 
-  BeginTextureMode(*output);
-    ClearBackground(PURPLE);
+  beginFrame(renderer);
+    clearFrame(renderer, PURPLE);
 
-    DrawTexturePro(backgroundTex, (Rectangle){(int)viewportPos.x % 64, (int)viewportPos.y % 64, (float)viewportWidth, (float)viewportHeight}, (Rectangle){0, 0, (float)viewportWidth, (float)viewportHeight}, Vector2Zero(), 0.0f, WHITE);
+    drawImage(renderer, &game->backgroundTex, (Rectangle){(int)game->viewportPos.x % (TILE_SIZE * 2), (int)game->viewportPos.y % (TILE_SIZE * 2), (float)viewportWidth, (float)viewportHeight}, (Rectangle){0, 0, (float)viewportWidth, (float)viewportHeight});
 
     double startTime = GetTime(); // Start timing
-    Int2 subGridPos = (Int2){myMod(player.pos.x, 32), myMod(player.pos.y, 32)};
+    Int2 subGridPos = (Int2){myMod(game->player.pos.x, TILE_SIZE), myMod(game->player.pos.y, TILE_SIZE)};
 
-    for (int i = 440; i > 0; i--) {
-      Int2 relPos = indexShit(i);
+    for (int i = VIEW_CELLS - 1; i > 0; i--) {
+      Int2 relPos = spiral[i];
 
-      if (readFromLevel((Int2){gridPos.x + relPos.x, gridPos.y + relPos.y})) {
-        drawTile((Vector2){relPos.x * 32 - subGridPos.x + screenCentre.x, relPos.y * 32 - subGridPos.y + screenCentre.y});
+      if (readFromLevel(game, (Int2){game->gridPos.x + relPos.x, game->gridPos.y + relPos.y})) {
+        drawTile(game, renderer, (Vector2){relPos.x * TILE_SIZE - subGridPos.x + screenCentre.x, relPos.y * TILE_SIZE - subGridPos.y + screenCentre.y});
       }
     }
-    if (readFromLevel(gridPos)) {
-      drawTile((Vector2){-subGridPos.x + screenCentre.x, -subGridPos.y + screenCentre.y});
+    if (readFromLevel(game, game->gridPos)) {
+      drawTile(game, renderer, (Vector2){-subGridPos.x + screenCentre.x, -subGridPos.y + screenCentre.y});
     }
 
     debugStats.levelDrawT = (GetTime() - startTime + debugStats.levelDrawT*19) / 20.0f; // End timing
 
-    DrawTexturePro(vignetteTex, (Rectangle){flicker / 2.0f, flicker / 2.0f, viewportWidth - flicker, viewportHeight - flicker}, (Rectangle){0, 0, viewportWidth, viewportHeight}, Vector2Zero(), 0.0f, WHITE);
+    drawImage(renderer, &game->vignetteTex, (Rectangle){game->flicker / 2.0f, game->flicker / 2.0f, viewportWidth - game->flicker, viewportHeight - game->flicker}, (Rectangle){0, 0, viewportWidth, viewportHeight});
 
-    DrawCircleV(screenCentre, playerConsts.size, RED);
-  EndTextureMode();
+    drawCircle(renderer, screenCentre, playerConsts.size, RED);
+  endFrame(renderer);
 }
 
-void unloadGame() {
-  UnloadTexture(backgroundTex);
-  UnloadTexture(vignetteTex);
+// Other players, positions in world space
+void drawPeers(GameState *game, Renderer *renderer, const Vector2 *positions, int count) {
+  beginFrame(renderer);
+    for (int i = 0; i < count; i++) {
+      drawCircle(renderer, Vector2Add(positions[i], game->globalOffset), playerConsts.size, ORANGE);
+    }
+  endFrame(renderer);
+}
+
+void unloadGame(GameState *game) {
+  unloadRenderImage(&game->backgroundTex);
+  unloadRenderImage(&game->vignetteTex);
+}
+
+// Region id of an open cell inside the tracked window, -1 for walls and cells outside it
+int getRegion(GameState *game, Int2 pos) {
+  if (!reachInWindow(game, pos)) return -1;
+  int label = game->reach.label[pos.y & LEVEL_MASK][pos.x & LEVEL_MASK];
+  if (label < 0) return -1;
+  return reachFind(game, label);
+}
+
+// Whether the player can walk to pos without leaving the tracked window
+bool isReachable(GameState *game, Int2 pos) {
+  int region = getRegion(game, pos);
+  return region >= 0 && region == getRegion(game, game->reach.centre);
 }
 
 static Quad rectToQuad(Rectangle rect) {
@@ -286,23 +395,32 @@ static Int2 indexShit(uint x) {
   return (Int2){outputx, outputy};
 }
 
-static bool readFromLevel(Int2 pos) {
-  pos = (Int2){myMod(pos.x, 21), myMod(pos.y, 21)};
+static bool readFromLevel(GameState *game, Int2 pos) {
+  pos = (Int2){pos.x & LEVEL_MASK, pos.y & LEVEL_MASK};
   int byte = pos.x / 8;
   int p = pos.x % 8;
-  return (world.level[pos.y][byte] >> p) % 2;
+  return (game->world.level[pos.y][byte] >> p) % 2;
 }
 
-static void writeToLevel(Int2 pos, bool state) {
-  pos = (Int2){myMod(pos.x, 21), myMod(pos.y, 21)};
+static void writeToLevel(GameState *game, Int2 pos, bool state) {
+  if (game->store != NULL) storeWrite(game->store, pos, state);
+  pos = (Int2){pos.x & LEVEL_MASK, pos.y & LEVEL_MASK};
   int byte = pos.x / 8;
   int p = pos.x % 8;
   char mask = 1 << p;
-  world.level[pos.y][byte] = ((world.level[pos.y][byte] & ~mask) | (state << p));
+  game->world.level[pos.y][byte] = ((game->world.level[pos.y][byte] & ~mask) | (state << p));
 }
 
-static void drawTile(Vector2 pos) {
-  Rectangle rect = (Rectangle){pos.x, pos.y, 32, 32};
+// Copies a previously generated cell back from the store, false if it still needs generating
+static bool restoreCell(GameState *game, Int2 pos) {
+  bool solid;
+  if (game->store == NULL || !storeRead(game->store, pos, &solid)) return false;
+  writeToLevel(game, pos, solid);
+  return true;
+}
+
+static void drawTile(GameState *game, Renderer *renderer, Vector2 pos) {
+  Rectangle rect = (Rectangle){pos.x, pos.y, TILE_SIZE, TILE_SIZE};
   Quad quad = rectToQuad(rect);
   Quad projQuad;
   for (int i = 0; i < 4; i++) {
@@ -310,32 +428,285 @@ static void drawTile(Vector2 pos) {
   }
 
   Vector2 middle = (Vector2){rect.x + rect.width / 2.0f, rect.y + rect.height / 2.0f};
-  float brightness = (100 / (rectPointDist(screenCentre, rect) * 0.08 + 1)) * (flicker / 256.0f + 0.875);
+  float brightness = (100 / (rectPointDist(screenCentre, rect) * 0.08 + 1)) * (game->flicker / 256.0f + 0.875);
 
-  DrawTriangleFan(projQuad.verts, 4, (Color){20, 20, 20, 255});
+  drawFan(renderer, projQuad.verts, 4, (Color){20, 20, 20, 255});
 
   if (quad.verts[3].y < screenCentre.y) {
     Vector2 face[4] = {quad.verts[0], quad.verts[1], projQuad.verts[1], projQuad.verts[0]};
     unsigned char faceBr = brightness * Vector2DotProduct((Vector2){0, 1}, Vector2Normalize(Vector2Subtract(screenCentre, middle)));
-    DrawTriangleFan(face, 4, (Color){faceBr, faceBr, faceBr, 255});
+    drawFan(renderer, face, 4, (Color){faceBr, faceBr, faceBr, 255});
   } else if (quad.verts[2].y > screenCentre.y) {
     Vector2 face[4] = {quad.verts[2], quad.verts[3], projQuad.verts[3], projQuad.verts[2]};
     unsigned char faceBr = brightness * Vector2DotProduct((Vector2){0, -1}, Vector2Normalize(Vector2Subtract(screenCentre, middle)));
-    DrawTriangleFan(face, 4, (Color){faceBr, faceBr, faceBr, 255});
+    drawFan(renderer, face, 4, (Color){faceBr, faceBr, faceBr, 255});
   }
   if (quad.verts[1].x < screenCentre.x) {
     Vector2 face[4] = {quad.verts[1], quad.verts[2], projQuad.verts[2], projQuad.verts[1]};
     unsigned char faceBr = brightness * Vector2DotProduct((Vector2){1, 0}, Vector2Normalize(Vector2Subtract(screenCentre, middle)));
-    DrawTriangleFan(face, 4, (Color){faceBr, faceBr, faceBr, 255});
+    drawFan(renderer, face, 4, (Color){faceBr, faceBr, faceBr, 255});
   } else if (quad.verts[3].x > screenCentre.x) {
     Vector2 face[4] = {quad.verts[3], quad.verts[0], projQuad.verts[0], projQuad.verts[3]};
     unsigned char faceBr = brightness * Vector2DotProduct((Vector2){-1, 0}, Vector2Normalize(Vector2Subtract(screenCentre, middle)));
-    DrawTriangleFan(face, 4, (Color){faceBr, faceBr, faceBr, 255});
+    drawFan(renderer, face, 4, (Color){faceBr, faceBr, faceBr, 255});
   }
 }
 
+// Black, clear in the middle and opaque towards the edges, like raylib's GenImageGradientRadial() at density 0.1
+// but made here so software frames come out the same whatever raylib was built with
+static Image genVignette(int width, int height) {
+  Color *pixels = malloc(width * height * sizeof(Color));
+  float radius = (width < height ? width : height) / 2.0f;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      float dx = x - width / 2.0f, dy = y - height / 2.0f;
+      float factor = Clamp((sqrtf(dx * dx + dy * dy) - radius * 0.1f) / (radius * 0.9f), 0, 1);
+      pixels[y * width + x] = (Color){0, 0, 0, (unsigned char)(255 * factor)};
+    }
+  }
+  return (Image){pixels, width, height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+}
+
 static uint myMod(int a, int b) {
   int r = a % b;
   if (r < 0) return (r + b);
   else return r;
 }
+
+// Per-world xorshift so worlds on different threads never share raylib's generator
+static int randomValue(uint *rng, int min, int max) {
+  uint x = *rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *rng = x;
+  return min + (int)(x % (uint)(max - min + 1));
+}
+
+static int reachFind(GameState *game, int label) {
+  while (game->reach.parent[label] != label) {
+    game->reach.parent[label] = game->reach.parent[game->reach.parent[label]];
+    label = game->reach.parent[label];
+  }
+  return label;
+}
+
+static void reachUnion(GameState *game, int a, int b) {
+  a = reachFind(game, a);
+  b = reachFind(game, b);
+  if (a < b) game->reach.parent[b] = a;
+  else if (b < a) game->reach.parent[a] = b;
+}
+
+static bool reachInWindow(GameState *game, Int2 pos) {
+  return abs(pos.x - game->reach.centre.x) <= VIEW_RADIUS && abs(pos.y - game->reach.centre.y) <= VIEW_RADIUS;
+}
+
+// Labels an open cell and joins it to its open neighbours, neighbours still at -1 are skipped
+static void reachLink(GameState *game, Int2 pos) {
+  short *label = &game->reach.label[pos.y & LEVEL_MASK][pos.x & LEVEL_MASK];
+  if (readFromLevel(game, pos)) {
+    *label = -1;
+    return;
+  }
+  if (game->reach.labelCount >= REACH_LABELS) {
+    reachRebuild(game, game->reach.centre);
+    return;
+  }
+  *label = game->reach.labelCount;
+  game->reach.parent[game->reach.labelCount] = game->reach.labelCount;
+  game->reach.labelCount++;
+
+  const Int2 dirs[4] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+  for (int i = 0; i < 4; i++) {
+    Int2 other = (Int2){pos.x + dirs[i].x, pos.y + dirs[i].y};
+    if (!reachInWindow(game, other)) continue;
+    int otherLabel = game->reach.label[other.y & LEVEL_MASK][other.x & LEVEL_MASK];
+    if (otherLabel >= 0) reachUnion(game, *label, otherLabel);
+  }
+}
+
+// Full relabel of the window, the only way to drop joins made through cells that have left it
+static void reachRebuild(GameState *game, Int2 centre) {
+  game->reach.centre = centre;
+  game->reach.labelCount = 0;
+  for (int y = 0; y < LEVEL_SIZE; y++) {
+    for (int x = 0; x < LEVEL_SIZE; x++) {
+      game->reach.label[y][x] = -1;
+    }
+  }
+  for (int y = -VIEW_RADIUS; y <= VIEW_RADIUS; y++) {
+    for (int x = -VIEW_RADIUS; x <= VIEW_RADIUS; x++) {
+      reachLink(game, (Int2){centre.x + x, centre.y + y});
+    }
+  }
+}
+
+// The line at start + inward * VIEW_SIZE has just left the window and taken its joins with it. A run of open cells
+// on it joined every open cell beside it on the edge line inside, so runs along the edge that a leaving run touched
+// together may now be apart. Runs of open cells are traced line by line in from the edge, union-found against the
+// line before, until each region is down to one piece still reaching the newest line. A piece that stops reaching
+// it can't join anything deeper, so it is a region of its own and gets a fresh label. Usually the pieces meet again
+// a few lines in, so this costs a few strip lengths. False if the labels ran out and the window was rebuilt
+static bool reachSplit(GameState *game, Int2 start, Int2 step, Int2 inward) {
+  Int2 edge = (Int2){start.x + inward.x * (VIEW_SIZE - 1), start.y + inward.y * (VIEW_SIZE - 1)};
+  short ids[VIEW_SIZE][VIEW_SIZE]; // Run of each traced cell by depth in from the edge, -1 for walls
+  short parent[VIEW_CELLS];
+  short seen[VIEW_CELLS];
+  short region[VIEW_SIZE]; // First edge run of the same region for runs being watched, -1 for the rest, -2 while touched
+  int roots[VIEW_SIZE];
+  int runs = 0, touched = -1;
+  for (int i = 0; i < VIEW_SIZE; i++) {
+    Int2 pos = (Int2){edge.x + step.x * i, edge.y + step.y * i};
+    int label = game->reach.label[pos.y & LEVEL_MASK][pos.x & LEVEL_MASK];
+    bool isLeaving = game->reach.label[(pos.y + inward.y) & LEVEL_MASK][(pos.x + inward.x) & LEVEL_MASK] >= 0;
+    if (label >= 0 && (i == 0 || ids[0][i - 1] < 0)) {
+      parent[runs] = runs;
+      region[runs] = -1;
+      roots[runs++] = reachFind(game, label);
+    }
+    ids[0][i] = label >= 0 ? runs - 1 : -1;
+
+    if (!isLeaving) touched = -1;
+    else if (label >= 0) {
+      if (touched >= 0 && touched != ids[0][i]) region[touched] = region[ids[0][i]] = -2;
+      touched = ids[0][i];
+    }
+  }
+
+  // Runs in different regions were never joined, so only regions with more than one touched run need watching
+  bool watching = false;
+  for (int run = 0; run < runs; run++) {
+    if (region[run] != -2) continue;
+    region[run] = -1;
+    int others = 0;
+    for (int other = run + 1; other < runs; other++) {
+      if (region[other] != -2 || roots[other] != roots[run]) continue;
+      region[other] = run;
+      others++;
+    }
+    if (others) region[run] = run;
+    watching = watching || others;
+  }
+  if (!watching) return true;
+
+  int count = runs, depth = 0;
+  for (int i = 0; i < count; i++) seen[i] = -1;
+  while (reachPending(parent, ids[depth], region, runs, seen, depth)) {
+    depth++;
+    for (int i = 0; i < VIEW_SIZE; i++) {
+      Int2 pos = (Int2){edge.x - inward.x * depth + step.x * i, edge.y - inward.y * depth + step.y * i};
+      if (game->reach.label[pos.y & LEVEL_MASK][pos.x & LEVEL_MASK] < 0) {
+        ids[depth][i] = -1;
+        continue;
+      }
+      if (i > 0 && ids[depth][i - 1] >= 0) ids[depth][i] = ids[depth][i - 1];
+      else {
+        parent[count] = count;
+        seen[count] = -1;
+        ids[depth][i] = count++;
+      }
+      if (ids[depth - 1][i] < 0) continue;
+      int a = runFind(parent, ids[depth - 1][i]), b = runFind(parent, ids[depth][i]);
+      if (a < b) parent[b] = a;
+      else if (b < a) parent[a] = b;
+    }
+  }
+
+  // One piece per region keeps the old label, preferably the one still open, the rest are wholly inside the lines
+  // traced and get fresh ones
+  short fresh[VIEW_CELLS];
+  bool relabel = false;
+  for (int i = 0; i < count; i++) fresh[i] = -1;
+  for (int run = 0; run < runs; run++) {
+    if (region[run] != run) continue;
+    int keep = -1;
+    for (int other = run; other < runs; other++) {
+      int piece = runFind(parent, other);
+      if (region[other] == run && (keep < 0 || seen[piece] == depth)) keep = piece;
+    }
+    for (int other = run; other < runs; other++) {
+      int piece = runFind(parent, other);
+      if (region[other] != run || piece == keep || fresh[piece] >= 0) continue;
+      if (game->reach.labelCount >= REACH_LABELS) {
+        reachRebuild(game, game->reach.centre);
+        return false;
+      }
+      fresh[piece] = game->reach.labelCount;
+      game->reach.parent[fresh[piece]] = fresh[piece];
+      game->reach.labelCount++;
+      relabel = true;
+    }
+  }
+  for (int d = 0; relabel && d <= depth; d++) {
+    for (int i = 0; i < VIEW_SIZE; i++) {
+      if (ids[d][i] < 0 || fresh[runFind(parent, ids[d][i])] < 0) continue;
+      Int2 pos = (Int2){edge.x - inward.x * d + step.x * i, edge.y - inward.y * d + step.y * i};
+      game->reach.label[pos.y & LEVEL_MASK][pos.x & LEVEL_MASK] = fresh[runFind(parent, ids[d][i])];
+    }
+  }
+  return true;
+}
+
+// Whether some watched region still has two pieces reaching line, which is the newest line traced at depth. Marks
+// each piece on the line in seen
+static bool reachPending(short *parent, const short *line, const short *region, int runs, short *seen, int depth) {
+  short open[VIEW_SIZE]; // Piece of each region seen on the line so far, by the region's first run
+  for (int i = 0; i < VIEW_SIZE; i++) {
+    if (line[i] >= 0) seen[runFind(parent, line[i])] = depth;
+  }
+  for (int run = 0; run < runs; run++) {
+    if (region[run] < 0) continue;
+    if (region[run] == run) open[run] = -1;
+    int piece = runFind(parent, run);
+    if (seen[piece] != depth) continue;
+    if (open[region[run]] >= 0 && open[region[run]] != piece) return true;
+    open[region[run]] = piece;
+  }
+  return false;
+}
+
+static int runFind(short *parent, int run) {
+  while (parent[run] != run) {
+    parent[run] = parent[parent[run]];
+    run = parent[run];
+  }
+  return run;
+}
+
+// Slides the window onto a freshly written strip, splitting any region that only held together through the line
+// leaving the other side
+static void trackStrip(GameState *game, Int2 centre, Int2 start, Int2 step, Int2 inward) {
+  game->stripCount++;
+  if (abs(centre.x - game->reach.centre.x) + abs(centre.y - game->reach.centre.y) != 1) {
+    reachRebuild(game, centre);
+    return;
+  }
+  game->reach.centre = centre;
+
+  for (int i = 0; i < VIEW_SIZE; i++) {
+    game->reach.label[(start.y + step.y * i) & LEVEL_MASK][(start.x + step.x * i) & LEVEL_MASK] = -1;
+  }
+  if (!reachSplit(game, start, step, inward)) return;
+  for (int i = 0; i < VIEW_SIZE; i++) {
+    reachLink(game, (Int2){start.x + step.x * i, start.y + step.y * i});
+  }
+}
+
+// Carves in from a strip along the player's row or column if nothing on it joins the player's region
+static void openStrip(GameState *game, Int2 start, Int2 step, Int2 inward) {
+  if (getRegion(game, game->reach.centre) < 0) return;
+  for (int i = 0; i < VIEW_SIZE; i++) {
+    if (isReachable(game, (Int2){start.x + step.x * i, start.y + step.y * i})) return;
+  }
+  int along = step.x ? game->reach.centre.x - start.x : game->reach.centre.y - start.y;
+  for (Int2 pos = (Int2){start.x + step.x * along, start.y + step.y * along}; ; pos = (Int2){pos.x + inward.x, pos.y + inward.y}) {
+    if (readFromLevel(game, pos)) {
+      writeToLevel(game, pos, 0);
+      reachLink(game, pos);
+      game->carveCount++;
+      game->lastCarve = pos;
+    }
+    if (isReachable(game, pos)) break;
+  }
+}
@@ -3,6 +3,7 @@
 
 #include "raylib.h"
 #include "raymath.h"
+#include "render.h"
 #include "global.h"
 
 // Typedefs
@@ -19,13 +20,61 @@ typedef struct PlayerData {
 } PlayerData;
 
 typedef struct WorldData {
-  unsigned char level[21][3];
+  unsigned char level[LEVEL_SIZE][LEVEL_SIZE / 8];
 } WorldData;
 
+#define REACH_LABELS (VIEW_CELLS * 2) // Past this the window is relabelled from scratch
+
+typedef struct ReachData {
+  short label[LEVEL_SIZE][LEVEL_SIZE]; // Region label per cell (indexed like level), -1 for walls
+  short parent[REACH_LABELS]; // Union-find forest over labels
+  int labelCount;
+  Int2 centre; // Grid position the tracked window is centred on
+} ReachData;
+
+typedef struct WorldStore WorldStore;
+
+typedef struct GameState {
+  PlayerData player;
+  Vector2 rawPos;
+  bool paused;
+  WorldData world;
+  ReachData reach;
+  Vector2 globalOffset;
+  Int2 gridPos;
+  Vector2 viewportPos;
+  uint rng;
+  uint moveRng; // Speed jitter only, so a client can predict movement without generating strips
+  float flicker;
+  uint flickerRng; // Drawing only, seeded with the world so headless frames repeat
+
+  uint stripCount;
+  uint carveCount;
+  Int2 lastCarve;
+  uint bumpCount; // Ticks the player was pushed out of a wall
+  Vector2 bumpNormal; // Direction of the latest push
+
+  WorldStore *store; // Persists every generated cell when set, NULL for throwaway worlds
+
+  RenderImage backgroundTex;
+  RenderImage vignetteTex;
+} GameState;
+
 // Function definitions
-void initGame();
-void updateGame(float delta);
-void drawGame(RenderTexture2D *output);
-void unloadGame();
+void initGame(GameState *game, Renderer *renderer, uint seed);
+void initWorld(GameState *game, uint seed);
+void attachStore(GameState *game, WorldStore *store);
+Vector2 readInput();
+uint packInput(Vector2 rawIn);
+Vector2 unpackInput(uint keys);
+void stepGame(GameState *game, Vector2 rawIn, float delta);
+void movePlayer(GameState *game, Vector2 rawIn, float delta);
+void settlePlayer(GameState *game);
+void rebuildReach(GameState *game);
+void drawGame(GameState *game, Renderer *renderer);
+void drawPeers(GameState *game, Renderer *renderer, const Vector2 *positions, int count);
+void unloadGame(GameState *game);
+int getRegion(GameState *game, Int2 pos);
+bool isReachable(GameState *game, Int2 pos);
 
 #endif
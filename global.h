@@ -4,6 +4,33 @@
 #include "raylib.h"
 #include "raymath.h"
 
+// Build configuration, override with -D (see build.sh)
+#ifndef VIEW_RADIUS
+#define VIEW_RADIUS 10 // Cells kept around the player in each direction
+#endif
+#ifndef TILE_SIZE
+#define TILE_SIZE 32 // Pixels per cell
+#endif
+
+#define VIEW_SIZE (VIEW_RADIUS * 2 + 1)
+#define VIEW_CELLS (VIEW_SIZE * VIEW_SIZE)
+
+// Level storage is a power-of-two ring around the view so wrapping is a mask instead of a division
+#if VIEW_RADIUS < 1 || VIEW_RADIUS > 63
+#error "VIEW_RADIUS must be between 1 and 63"
+#elif VIEW_SIZE <= 8
+#define LEVEL_SIZE 8
+#elif VIEW_SIZE <= 16
+#define LEVEL_SIZE 16
+#elif VIEW_SIZE <= 32
+#define LEVEL_SIZE 32
+#elif VIEW_SIZE <= 64
+#define LEVEL_SIZE 64
+#else
+#define LEVEL_SIZE 128
+#endif
+#define LEVEL_MASK (LEVEL_SIZE - 1)
+
 // Typedefs
 typedef enum Screen {UNKNOWN = -1, MENU = 0, GAME} Screen;
 typedef unsigned int uint;
@@ -1,7 +1,14 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "raylib.h"
 #include "raymath.h"
 #include "game.h"
+#include "replay.h"
+#include "store.h"
+#include "net.h"
+#include "render.h"
+#include "particles.h"
 #include "global.h"
 
 // Local function definitions
@@ -12,15 +19,38 @@ static void draw();
 Screen currentScreen = GAME;
 struct DebugStats debugStats = {0, 0, 0, 0};
 static RenderTexture2D viewport;
+static Renderer renderer;
+static Particles particles;
+static GameState game;
+static Replay replay;
+static WorldStore store;
+static bool persistent = false;
+static NetClient client;
+static bool networked = false;
+static GameState *player = &game; // The simulation being shown, the client's prediction when networked
 
-int main(void) {
+int main(int argc, char **argv) {
   SetConfigFlags(FLAG_WINDOW_RESIZABLE);
   InitWindow(viewportWidth, viewportHeight, "Generic Game");
   SetTargetFPS(60);
   SetTraceLogLevel(LOG_WARNING);
   viewport = LoadRenderTexture(viewportWidth, viewportHeight);
+  initRenderer(&renderer, RENDER_RAYLIB, &viewport, 1);
 
-  initGame();
+  // Either --connect host [port] to join a server, or an optional world file to resume from and save back to
+  if (argc > 2 && strcmp(argv[1], "--connect") == 0) {
+    networked = connectClient(&client, argv[2], argc > 3 ? atoi(argv[3]) : NET_PORT);
+    if (!networked) TraceLog(LOG_WARNING, "Could not connect to %s", argv[2]);
+    else player = &client.game;
+  }
+  initGame(player, &renderer, GetRandomValue(1, 0x7fffffff));
+  initParticles(&particles, GetRandomValue(1, 0x7fffffff));
+  if (argc > 1 && !networked) {
+    persistent = openWorldStore(&store, argv[1]);
+    if (persistent) attachStore(&game, &store);
+    else TraceLog(LOG_WARNING, "Could not open world %s", argv[1]);
+  }
+  beginRecording(&replay, game.rng);
 
   while (!WindowShouldClose()) {
     double startTime = GetTime(); // Start timing
@@ -32,10 +62,23 @@ int main(void) {
 
   switch (currentScreen) {
     //case MENU: unloadMenu(); break;
-    case GAME: unloadGame(); break;
+    case GAME: unloadGame(player); break;
     default: break;
   }
 
+  if (networked) disconnectClient(&client);
+  if (persistent) {
+    recordStore(&replay, &store); // Before the save writes over the pages the session started from
+    if (!saveWorldStore(&store, &game)) TraceLog(LOG_WARNING, "Could not save world %s", argv[1]);
+    closeWorldStore(&store);
+  }
+
+  // Every local session leaves a replay behind for reproducing what happened
+  if (!networked && !saveReplay(&replay, "last.replay")) TraceLog(LOG_WARNING, "Could not save last.replay");
+  unloadReplay(&replay);
+
+  unloadParticles(&particles);
+  unloadRenderer(&renderer);
   UnloadRenderTexture(viewport);
   CloseWindow();
 
@@ -46,7 +89,14 @@ static void update(float delta) {
   switch (currentScreen)
   {
     //case MENU: updateMenu(); break;
-    case GAME: updateGame(delta); break;
+    case GAME: {
+      Vector2 rawIn = readInput();
+      if (networked) {
+        clientReceive(&client);
+        clientTick(&client, rawIn, delta);
+      } else stepGame(&game, rawIn, recordTick(&replay, &game, rawIn, delta));
+      updateParticles(&particles, player, delta);
+    } break;
     default: break;
   }
 }
@@ -64,7 +114,15 @@ static void draw() {
   switch (currentScreen)
   {
     //case MENU: updateMenu(); break;
-    case GAME: drawGame(&viewport); break;
+    case GAME: {
+      drawGame(player, &renderer);
+      if (networked) {
+        Vector2 positions[NET_MAX_PLAYERS];
+        for (int i = 0; i < client.peerCount; i++) positions[i] = client.peers[i].pos;
+        drawPeers(player, &renderer, positions, client.peerCount);
+      }
+      drawParticles(&particles, player, &renderer);
+    } break;
     default: break;
   }
 
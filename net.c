@@ -0,0 +1,456 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "net.h"
+#include "game.h"
+#include "store.h"
+#include "global.h"
+
+// Every packet is a bit stream starting with a 2 bit NetPacket type
+//   HELLO:    nothing else
+//   WELCOME:  id:6
+//   INPUT:    ackTick:32 count:3 newestSeq:32 then count * (keys:4 deltaUs:20), newest first
+//   SNAPSHOT: tick:32 baseTick:32 ackSeq:32 moveRng:32 x:32 y:32 (raw float bits, exact so the client can reconcile)
+//             axis:1 lineMask:LEVEL_SIZE then LEVEL_SIZE bits per changed row (axis 0) or column (axis 1)
+//             peerCount:7 then peerCount * (id:6 dx:16 dy:16), offsets from this player in 1/NET_POS_SCALE px
+// Levels are delta encoded against the newest snapshot the client acknowledged (baseTick, 0 for an empty level),
+// sending whichever of rows or columns changed fewer lines, so a new strip costs one line
+
+// Typedefs
+typedef struct BitStream {
+  unsigned char *data;
+  int size; // Bytes
+  int bit;
+  bool overflow;
+} BitStream;
+
+// Local function definitions
+static void writeBits(BitStream *stream, uint value, int count);
+static uint readBits(BitStream *stream, int count);
+static int openSocket(int port);
+static void sendPacket(int fd, const struct sockaddr_in *addr, BitStream *stream, uint64_t *bytes);
+static NetSlot *findSlot(NetServer *server, const struct sockaddr_in *addr);
+static void joinServer(NetServer *server, const struct sockaddr_in *addr, double time);
+static void readInputs(NetSlot *slot, BitStream *stream, uint tick);
+static void sendSnapshot(NetServer *server, NetSlot *slot);
+static void writeLevel(BitStream *stream, NetLevel level, NetLevel base);
+static bool readLevel(BitStream *stream, NetLevel level);
+static void readSnapshot(NetClient *client, BitStream *stream);
+static void rejoinServer(NetClient *client);
+static uint quantiseDelta(float delta);
+static uint floatBits(float value);
+static float bitsFloat(uint bits);
+static bool levelBit(NetLevel level, int x, int y);
+static void setLevelBit(NetLevel level, int x, int y, bool state);
+
+// Constants
+static const NetLevel emptyLevel;
+
+bool startServer(NetServer *server, int port) {
+  *server = (NetServer){0};
+  server->fd = openSocket(port);
+  if (server->fd < 0) return false;
+
+  struct sockaddr_in bound;
+  socklen_t length = sizeof(bound);
+  getsockname(server->fd, (struct sockaddr *)&bound, &length);
+  server->port = ntohs(bound.sin_port);
+  server->tick = 1;
+  openWorldStore(&server->store, NULL);
+  return true;
+}
+
+// Drains every waiting packet, applies inputs as they arrive, then sends each client a snapshot
+void serverTick(NetServer *server, double time) {
+  unsigned char buffer[NET_PACKET_SIZE];
+  struct sockaddr_in addr;
+  socklen_t addrLength = sizeof(addr);
+  ssize_t size;
+
+  // Every player earns the time that passed since the last tick to spend on inputs
+  double elapsedUs = server->tick > 1 ? fmax(time - server->lastTime, 0) * 1000000.0 : 0;
+  server->lastTime = time;
+  for (int i = 0; i < NET_MAX_PLAYERS; i++) {
+    NetSlot *slot = &server->slots[i];
+    if (slot->active) slot->budgetUs = fmin(slot->budgetUs + elapsedUs + 0.5, NET_MAX_BUDGET_US);
+  }
+
+  while ((size = recvfrom(server->fd, buffer, sizeof(buffer), 0, (struct sockaddr *)&addr, &addrLength)) > 0) {
+    server->bytesIn += size;
+    server->packetsIn++;
+    BitStream stream = {buffer, size, 0, false};
+    NetSlot *slot = findSlot(server, &addr);
+
+    switch (readBits(&stream, 2)) {
+      case NET_HELLO: joinServer(server, &addr, time); break;
+      case NET_INPUT:
+        if (slot == NULL) break;
+        slot->lastHeard = time;
+        readInputs(slot, &stream, server->tick);
+        break;
+      default: break;
+    }
+    addrLength = sizeof(addr);
+  }
+
+  for (int i = 0; i < NET_MAX_PLAYERS; i++) {
+    NetSlot *slot = &server->slots[i];
+    if (!slot->active) continue;
+    if (time - slot->lastHeard > NET_TIMEOUT) {
+      slot->active = false;
+      continue;
+    }
+    sendSnapshot(server, slot);
+  }
+  server->tick++;
+}
+
+void stopServer(NetServer *server) {
+  close(server->fd);
+  closeWorldStore(&server->store);
+}
+
+bool connectClient(NetClient *client, const char *host, int port) {
+  *client = (NetClient){0};
+  client->id = -1;
+  client->nextSeq = 1;
+  client->server.sin_family = AF_INET;
+  client->server.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &client->server.sin_addr) != 1) return false;
+
+  client->fd = openSocket(0);
+  if (client->fd < 0) return false;
+  initWorld(&client->game, 1);
+  return true;
+}
+
+// Sends this tick's input and predicts it locally, until welcomed it just keeps saying hello
+void clientTick(NetClient *client, Vector2 rawIn, float delta) {
+  unsigned char buffer[64];
+  BitStream stream = {buffer, sizeof(buffer), 0, false};
+
+  client->silence += delta;
+  if (client->id >= 0 && client->silence > NET_TIMEOUT) rejoinServer(client);
+  if (client->id < 0) {
+    writeBits(&stream, NET_HELLO, 2);
+    sendPacket(client->fd, &client->server, &stream, &client->bytesOut);
+    return;
+  }
+
+  if (client->nextSeq - client->ackSeq > NET_PENDING) client->ackSeq = client->nextSeq - NET_PENDING;
+  NetInput *input = &client->pending[client->nextSeq % NET_PENDING];
+  *input = (NetInput){client->nextSeq++, packInput(rawIn), quantiseDelta(delta)};
+  movePlayer(&client->game, rawIn, input->deltaUs / 1000000.0f);
+
+  uint count = client->nextSeq - 1 - client->ackSeq;
+  if (count > NET_INPUT_REDUNDANCY) count = NET_INPUT_REDUNDANCY;
+  if (count < 1) count = 1;
+  writeBits(&stream, NET_INPUT, 2);
+  writeBits(&stream, client->snapshotTick, 32);
+  writeBits(&stream, count, 3);
+  writeBits(&stream, input->seq, 32);
+  for (uint i = 0; i < count; i++) {
+    const NetInput *sent = &client->pending[(input->seq - i) % NET_PENDING];
+    writeBits(&stream, sent->keys, 4);
+    writeBits(&stream, sent->deltaUs, 20);
+  }
+  sendPacket(client->fd, &client->server, &stream, &client->bytesOut);
+}
+
+void clientReceive(NetClient *client) {
+  unsigned char buffer[NET_PACKET_SIZE];
+  ssize_t size;
+  while ((size = recv(client->fd, buffer, sizeof(buffer), 0)) > 0) {
+    client->bytesIn += size;
+    BitStream stream = {buffer, size, 0, false};
+    switch (readBits(&stream, 2)) {
+      case NET_WELCOME:
+        if (client->id < 0) client->id = readBits(&stream, 6);
+        client->silence = 0;
+        break;
+      case NET_SNAPSHOT: readSnapshot(client, &stream); break;
+      default: break;
+    }
+  }
+}
+
+void disconnectClient(NetClient *client) {
+  close(client->fd);
+  client->fd = -1;
+}
+
+static void writeBits(BitStream *stream, uint value, int count) {
+  if (stream->bit + count > stream->size * 8) {
+    stream->overflow = true;
+    return;
+  }
+  for (int i = 0; i < count; i++, stream->bit++) {
+    unsigned char mask = 1 << (stream->bit % 8);
+    if ((value >> i) & 1) stream->data[stream->bit / 8] |= mask;
+    else stream->data[stream->bit / 8] &= ~mask;
+  }
+}
+
+static uint readBits(BitStream *stream, int count) {
+  if (stream->bit + count > stream->size * 8) {
+    stream->overflow = true;
+    return 0;
+  }
+  uint value = 0;
+  for (int i = 0; i < count; i++, stream->bit++) {
+    value |= (uint)((stream->data[stream->bit / 8] >> (stream->bit % 8)) & 1) << i;
+  }
+  return value;
+}
+
+static int openSocket(int port) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) return -1;
+
+  struct sockaddr_in addr = {0};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void sendPacket(int fd, const struct sockaddr_in *addr, BitStream *stream, uint64_t *bytes) {
+  if (stream->overflow) return;
+  int size = (stream->bit + 7) / 8;
+  if (sendto(fd, stream->data, size, 0, (const struct sockaddr *)addr, sizeof(*addr)) == size) *bytes += size;
+}
+
+static NetSlot *findSlot(NetServer *server, const struct sockaddr_in *addr) {
+  for (int i = 0; i < NET_MAX_PLAYERS; i++) {
+    NetSlot *slot = &server->slots[i];
+    if (slot->active && slot->addr.sin_addr.s_addr == addr->sin_addr.s_addr && slot->addr.sin_port == addr->sin_port) return slot;
+  }
+  return NULL;
+}
+
+// New players spawn at the origin; the shared store hands them whatever the others already generated there
+static void joinServer(NetServer *server, const struct sockaddr_in *addr, double time) {
+  NetSlot *slot = findSlot(server, addr);
+  for (int i = 0; slot == NULL && i < NET_MAX_PLAYERS; i++) {
+    if (server->slots[i].active) continue;
+    slot = &server->slots[i];
+    *slot = (NetSlot){.active = true, .addr = *addr};
+    initWorld(&slot->game, 0x9e3779b9u * server->tick ^ (i + 1));
+    attachStore(&slot->game, &server->store);
+  }
+  if (slot == NULL) return;
+  slot->lastHeard = time;
+
+  unsigned char buffer[4];
+  BitStream stream = {buffer, sizeof(buffer), 0, false};
+  writeBits(&stream, NET_WELCOME, 2);
+  writeBits(&stream, slot - server->slots, 6);
+  sendPacket(server->fd, addr, &stream, &server->bytesOut);
+  server->packetsOut++;
+}
+
+// Steps the player once per input it hasn't seen yet, oldest first. Each step is cut to what is left of the slot's
+// budget, still taken so the rng stays in step with the client's prediction
+static void readInputs(NetSlot *slot, BitStream *stream, uint tick) {
+  uint ackTick = readBits(stream, 32);
+  uint count = readBits(stream, 3);
+  uint newest = readBits(stream, 32);
+  NetInput inputs[8];
+  for (uint i = 0; i < count; i++) {
+    inputs[i] = (NetInput){newest - i, readBits(stream, 4), readBits(stream, 20)};
+  }
+  if (stream->overflow) return;
+
+  if (ackTick > slot->ackTick && ackTick < tick) slot->ackTick = ackTick;
+  for (int i = count - 1; i >= 0; i--) {
+    if (inputs[i].seq <= slot->lastSeq) continue;
+    uint deltaUs = inputs[i].deltaUs < NET_MAX_DELTA_US ? inputs[i].deltaUs : NET_MAX_DELTA_US;
+    if (deltaUs > slot->budgetUs) deltaUs = slot->budgetUs;
+    slot->budgetUs -= deltaUs;
+    stepGame(&slot->game, unpackInput(inputs[i].keys), deltaUs / 1000000.0f);
+    slot->lastSeq = inputs[i].seq;
+  }
+}
+
+static void sendSnapshot(NetServer *server, NetSlot *slot) {
+  uint baseTick = 0;
+  const unsigned char (*base)[LEVEL_SIZE / 8] = emptyLevel;
+  if (slot->ackTick != 0 && server->tick - slot->ackTick < NET_HISTORY && slot->sentTick[slot->ackTick % NET_HISTORY] == slot->ackTick) {
+    baseTick = slot->ackTick;
+    base = slot->sent[baseTick % NET_HISTORY];
+  }
+
+  unsigned char buffer[NET_PACKET_SIZE];
+  BitStream stream = {buffer, sizeof(buffer), 0, false};
+  writeBits(&stream, NET_SNAPSHOT, 2);
+  writeBits(&stream, server->tick, 32);
+  writeBits(&stream, baseTick, 32);
+  writeBits(&stream, slot->lastSeq, 32);
+  writeBits(&stream, slot->game.moveRng, 32);
+  writeBits(&stream, floatBits(slot->game.rawPos.x), 32);
+  writeBits(&stream, floatBits(slot->game.rawPos.y), 32);
+  writeLevel(&stream, slot->game.world.level, (unsigned char (*)[LEVEL_SIZE / 8])base);
+
+  // Only players near enough to be seen
+  NetPeer peers[NET_MAX_PLAYERS];
+  int peerCount = 0;
+  const float range = (VIEW_RADIUS + 1) * TILE_SIZE;
+  for (int i = 0; i < NET_MAX_PLAYERS; i++) {
+    NetSlot *other = &server->slots[i];
+    if (!other->active || other == slot) continue;
+    Vector2 offset = Vector2Subtract(other->game.rawPos, slot->game.rawPos);
+    if (fabsf(offset.x) > range || fabsf(offset.y) > range) continue;
+    peers[peerCount++] = (NetPeer){i, offset};
+  }
+  writeBits(&stream, peerCount, 7);
+  for (int i = 0; i < peerCount; i++) {
+    writeBits(&stream, peers[i].id, 6);
+    writeBits(&stream, (int)roundf(peers[i].pos.x * NET_POS_SCALE) & 0xffff, 16);
+    writeBits(&stream, (int)roundf(peers[i].pos.y * NET_POS_SCALE) & 0xffff, 16);
+  }
+
+  memcpy(slot->sent[server->tick % NET_HISTORY], slot->game.world.level, sizeof(NetLevel));
+  slot->sentTick[server->tick % NET_HISTORY] = server->tick;
+  sendPacket(server->fd, &slot->addr, &stream, &server->bytesOut);
+  server->packetsOut++;
+}
+
+static void writeLevel(BitStream *stream, NetLevel level, NetLevel base) {
+  bool rows[LEVEL_SIZE] = {0}, columns[LEVEL_SIZE] = {0};
+  int rowCount = 0, columnCount = 0;
+  for (int y = 0; y < LEVEL_SIZE; y++) {
+    for (int x = 0; x < LEVEL_SIZE; x++) {
+      if (levelBit(level, x, y) == levelBit(base, x, y)) continue;
+      rowCount += !rows[y];
+      columnCount += !columns[x];
+      rows[y] = columns[x] = true;
+    }
+  }
+
+  bool byColumn = columnCount < rowCount;
+  bool *lines = byColumn ? columns : rows;
+  writeBits(stream, byColumn, 1);
+  for (int i = 0; i < LEVEL_SIZE; i++) writeBits(stream, lines[i], 1);
+  for (int i = 0; i < LEVEL_SIZE; i++) {
+    if (!lines[i]) continue;
+    for (int j = 0; j < LEVEL_SIZE; j++) {
+      writeBits(stream, byColumn ? levelBit(level, i, j) : levelBit(level, j, i), 1);
+    }
+  }
+}
+
+// Overwrites the changed lines of level, which must already hold the baseline
+static bool readLevel(BitStream *stream, NetLevel level) {
+  bool byColumn = readBits(stream, 1);
+  bool lines[LEVEL_SIZE];
+  for (int i = 0; i < LEVEL_SIZE; i++) lines[i] = readBits(stream, 1);
+  for (int i = 0; i < LEVEL_SIZE; i++) {
+    if (!lines[i]) continue;
+    for (int j = 0; j < LEVEL_SIZE; j++) {
+      bool state = readBits(stream, 1);
+      if (byColumn) setLevelBit(level, i, j, state);
+      else setLevelBit(level, j, i, state);
+    }
+  }
+  return !stream->overflow;
+}
+
+// Takes the server's word for the player and level, then replays the inputs it hasn't seen yet on top
+static void readSnapshot(NetClient *client, BitStream *stream) {
+  uint tick = readBits(stream, 32);
+  uint baseTick = readBits(stream, 32);
+  uint ackSeq = readBits(stream, 32);
+  uint moveRng = readBits(stream, 32);
+  Vector2 rawPos = {bitsFloat(readBits(stream, 32)), bitsFloat(readBits(stream, 32))};
+  if (stream->overflow || tick <= client->snapshotTick) return;
+  if (baseTick != 0 && client->receivedTick[baseTick % NET_HISTORY] != baseTick) return;
+
+  NetLevel level;
+  memcpy(level, baseTick != 0 ? client->received[baseTick % NET_HISTORY] : emptyLevel, sizeof(NetLevel));
+  if (!readLevel(stream, level)) return;
+
+  int peerCount = readBits(stream, 7);
+  NetPeer peers[NET_MAX_PLAYERS];
+  for (int i = 0; i < peerCount && i < NET_MAX_PLAYERS; i++) {
+    int id = readBits(stream, 6);
+    int16_t dx = readBits(stream, 16);
+    int16_t dy = readBits(stream, 16);
+    peers[i] = (NetPeer){id, Vector2Add(rawPos, (Vector2){dx / (float)NET_POS_SCALE, dy / (float)NET_POS_SCALE})};
+  }
+  if (stream->overflow || peerCount > NET_MAX_PLAYERS) return;
+
+  memcpy(client->received[tick % NET_HISTORY], level, sizeof(NetLevel));
+  client->receivedTick[tick % NET_HISTORY] = tick;
+  client->snapshotTick = tick;
+  client->silence = 0;
+  memcpy(client->peers, peers, peerCount * sizeof(NetPeer));
+  client->peerCount = peerCount;
+
+  Vector2 predicted = client->game.rawPos;
+  GameState *game = &client->game;
+  memcpy(game->world.level, level, sizeof(NetLevel));
+  game->rawPos = rawPos;
+  game->moveRng = moveRng;
+  settlePlayer(game);
+  if (ackSeq > client->ackSeq) client->ackSeq = ackSeq;
+  if (client->nextSeq - client->ackSeq > NET_PENDING) client->ackSeq = client->nextSeq - NET_PENDING;
+  for (uint seq = client->ackSeq + 1; seq < client->nextSeq; seq++) {
+    const NetInput *input = &client->pending[seq % NET_PENDING];
+    movePlayer(game, unpackInput(input->keys), input->deltaUs / 1000000.0f);
+  }
+  if (Vector2Distance(predicted, game->rawPos) > 0.5f) client->corrections++;
+}
+
+// The server has freed our slot or restarted, so its ticks and baselines mean nothing now. Sequence numbers carry
+// on, a slot that did survive only applies inputs newer than it has seen
+static void rejoinServer(NetClient *client) {
+  client->id = -1;
+  client->silence = 0;
+  client->snapshotTick = 0;
+  memset(client->receivedTick, 0, sizeof(client->receivedTick));
+  client->ackSeq = client->nextSeq - 1;
+  client->peerCount = 0;
+  client->rejoins++;
+}
+
+static uint quantiseDelta(float delta) {
+  float deltaUs = delta * 1000000.0f + 0.5f;
+  if (deltaUs < 0) return 0;
+  if (deltaUs > NET_MAX_DELTA_US) return NET_MAX_DELTA_US;
+  return (uint)deltaUs;
+}
+
+static uint floatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static float bitsFloat(uint bits) {
+  uint32_t value = bits;
+  float result;
+  memcpy(&result, &value, sizeof(result));
+  return result;
+}
+
+static bool levelBit(NetLevel level, int x, int y) {
+  return (level[y][x / 8] >> (x % 8)) & 1;
+}
+
+static void setLevelBit(NetLevel level, int x, int y, bool state) {
+  unsigned char mask = 1 << (x % 8);
+  level[y][x / 8] = (level[y][x / 8] & ~mask) | (state ? mask : 0);
+}
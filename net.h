@@ -0,0 +1,92 @@
+#ifndef NET_H
+#define NET_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "game.h"
+#include "store.h"
+#include "global.h"
+
+// Authoritative UDP server and predicting client sharing one generated world
+
+#define NET_PORT 27960
+#define NET_MAX_PLAYERS 64
+#define NET_HISTORY 32 // Snapshots remembered on both ends as delta baselines, power of two
+#define NET_PENDING 64 // Unacknowledged inputs a client keeps for prediction, power of two
+#define NET_INPUT_REDUNDANCY 4 // Latest inputs repeated in each input packet to ride out loss
+#define NET_POS_SCALE 4 // Quantisation steps per pixel for other players' positions
+#define NET_TIMEOUT 5.0 // Seconds of silence before a client's slot is freed
+#define NET_MAX_DELTA_US 100000 // Longest frame an input may claim, longer ones are clamped on both ends
+#define NET_MAX_BUDGET_US 250000 // Server time a slot may bank for late or bunched inputs
+#define NET_PACKET_SIZE (LEVEL_SIZE * LEVEL_SIZE / 8 + 1024) // Fits a full level and every peer
+
+// Typedefs
+typedef enum NetPacket {NET_HELLO = 0, NET_WELCOME, NET_INPUT, NET_SNAPSHOT} NetPacket;
+
+typedef unsigned char NetLevel[LEVEL_SIZE][LEVEL_SIZE / 8];
+
+typedef struct NetInput {
+  uint seq;
+  uint keys;
+  uint deltaUs;
+} NetInput;
+
+typedef struct NetPeer {
+  int id;
+  Vector2 pos;
+} NetPeer;
+
+typedef struct NetSlot {
+  bool active;
+  struct sockaddr_in addr;
+  double lastHeard;
+  GameState game;
+  uint lastSeq; // Newest input applied
+  uint budgetUs; // Server time not yet spent on this player's inputs, so a client can't move faster than the clock
+  uint ackTick; // Newest snapshot the client confirmed
+  NetLevel sent[NET_HISTORY]; // Level as sent, by tick % NET_HISTORY
+  uint sentTick[NET_HISTORY];
+} NetSlot;
+
+typedef struct NetServer {
+  int fd, port;
+  uint tick;
+  double lastTime;
+  WorldStore store; // In-memory only, shared by every player so they all walk the same world
+  NetSlot slots[NET_MAX_PLAYERS];
+  // Stats
+  uint64_t bytesIn, bytesOut, packetsIn, packetsOut;
+} NetServer;
+
+typedef struct NetClient {
+  int fd;
+  struct sockaddr_in server;
+  int id; // -1 until welcomed
+  float silence; // Seconds since the server was last heard, past NET_TIMEOUT the slot is assumed gone
+  GameState game; // Local player, predicted ahead of the server
+
+  uint snapshotTick; // Newest snapshot applied
+  NetLevel received[NET_HISTORY];
+  uint receivedTick[NET_HISTORY];
+
+  NetInput pending[NET_PENDING];
+  uint nextSeq, ackSeq;
+
+  NetPeer peers[NET_MAX_PLAYERS];
+  int peerCount;
+  // Stats
+  uint64_t bytesIn, bytesOut, corrections, rejoins;
+} NetClient;
+
+// Function definitions
+bool startServer(NetServer *server, int port);
+void serverTick(NetServer *server, double time);
+void stopServer(NetServer *server);
+bool connectClient(NetClient *client, const char *host, int port);
+void clientTick(NetClient *client, Vector2 rawIn, float delta);
+void clientReceive(NetClient *client);
+void disconnectClient(NetClient *client);
+
+#endif
@@ -0,0 +1,90 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "game.h"
+#include "net.h"
+#include "tool.h"
+#include "global.h"
+
+// Network benchmark: a server and 2, 16 then 64 wandering clients over localhost in one process
+// usage: netbench [ticks] [lag ticks] [stall ticks], clients only read their socket every lag ticks to mimic a slow
+// link, and the first client freezes for stall ticks partway through as if its window were dragged
+
+// Local function definitions
+static void runBench(int clientCount, int ticks, int lag, int stall);
+
+// Variables
+static NetServer server;
+
+int main(int argc, char **argv) {
+  int ticks = argc > 1 ? atoi(argv[1]) : 600;
+  int lag = argc > 2 ? atoi(argv[2]) : 1;
+  int stall = argc > 3 ? atoi(argv[3]) : 0;
+  if (ticks < 1 || lag < 1 || stall < 0) {
+    fprintf(stderr, "usage: %s [ticks] [lag ticks] [stall ticks]\n", argv[0]);
+    return 1;
+  }
+
+  const int clientCounts[] = {2, 16, 64};
+  for (int i = 0; i < 3; i++) runBench(clientCounts[i], ticks, lag, stall);
+  return 0;
+}
+
+// Ticks are simulated back to back at a virtual 60Hz, so per second figures are per 60 ticks
+static void runBench(int clientCount, int ticks, int lag, int stall) {
+  if (!startServer(&server, 0)) {
+    fprintf(stderr, "could not start server\n");
+    return;
+  }
+  NetClient *clients = calloc(clientCount, sizeof(NetClient));
+  uint *keys = calloc(clientCount, sizeof(uint));
+  for (int i = 0; i < clientCount; i++) connectClient(&clients[i], "127.0.0.1", server.port);
+
+  const float delta = 1.0f / 60.0f;
+  const int stallStart = ticks / 6;
+  double totalT = 0, slowestT = 0;
+  for (int tick = 0; tick < ticks; tick++) {
+    for (int i = 0; i < clientCount; i++) {
+      // The stalled client skips its ticks, then makes up for them in one long frame
+      if (i == 0 && tick >= stallStart && tick < stallStart + stall) continue;
+      float clientDelta = i == 0 && stall > 0 && tick == stallStart + stall ? (stall + 1) * delta : delta;
+
+      // Each client picks a new direction now and then
+      if ((tick + i * 7) % 30 == 0) keys[i] = rand() % 16;
+      if ((tick + i) % lag == 0) clientReceive(&clients[i]);
+      clientTick(&clients[i], unpackInput(keys[i]), clientDelta);
+    }
+
+    double startTime = now();
+    serverTick(&server, tick * delta);
+    double tickT = now() - startTime;
+    totalT += tickT;
+    if (tickT > slowestT) slowestT = tickT;
+  }
+
+  uint64_t bytesIn = 0, bytesOut = 0, corrections = 0, rejoins = 0;
+  int behind = 0; // Clients whose newest snapshot is more than a lag behind the server
+  for (int i = 0; i < clientCount; i++) {
+    clientReceive(&clients[i]);
+    bytesIn += clients[i].bytesIn;
+    bytesOut += clients[i].bytesOut;
+    corrections += clients[i].corrections;
+    rejoins += clients[i].rejoins;
+    behind += server.tick - clients[i].snapshotTick > (uint)lag + 1;
+    disconnectClient(&clients[i]);
+  }
+
+  double seconds = ticks * delta;
+  printf("%d clients, %d ticks, %d ticks of lag, %d ticks of stall\n", clientCount, ticks, lag, stall);
+  printf("  down: %.0f bytes/s per client (%.1f bytes per snapshot)\n", bytesIn / seconds / clientCount, server.packetsOut ? (double)server.bytesOut / server.packetsOut : 0);
+  printf("  up: %.0f bytes/s per client\n", bytesOut / seconds / clientCount);
+  printf("  server tick: %.0fus average, %.0fus slowest\n", totalT / ticks * 1000000, slowestT * 1000000);
+  printf("  corrections: %llu\n", (unsigned long long)corrections);
+  printf("  rejoins: %llu, clients out of touch at the end: %d\n", (unsigned long long)rejoins, behind);
+
+  free(clients);
+  free(keys);
+  stopServer(&server);
+}
@@ -0,0 +1,68 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "game.h"
+#include "particles.h"
+#include "render.h"
+#include "tool.h"
+#include "global.h"
+
+// Particle benchmark: keeps a pool topped up to the target count inside a generated world and times each update on one core,
+// then times batching them into the software renderer
+// usage: particlebench [particles] [frames]
+
+// Variables
+static GameState game;
+static Particles particles;
+static Renderer renderer;
+
+int main(int argc, char **argv) {
+  int target = argc > 1 ? atoi(argv[1]) : 100000;
+  int frames = argc > 2 ? atoi(argv[2]) : 600;
+  if (target < 1 || target > PARTICLE_CAPACITY || frames < 1) {
+    fprintf(stderr, "usage: %s [particles, up to %d] [frames]\n", argv[0], PARTICLE_CAPACITY);
+    return 1;
+  }
+
+  initWorld(&game, 1);
+  for (int i = 0; i < 600; i++) stepGame(&game, (Vector2){1, 1}, 1.0f / 60.0f);
+  if (!initParticles(&particles, 1) || !initRenderer(&renderer, RENDER_SOFTWARE, NULL, 1)) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  // Bursts of sparks from open cells all over the screen, so most of the pool is moving fast and plenty hit walls
+  double updateT = 0, slowestT = 0, drawT = 0;
+  long retired = 0;
+  for (int frame = 0; frame < frames; frame++) {
+    ParticlePool *pool = &particles.pools[PARTICLE_SPARK];
+    while (pool->count < target) {
+      Vector2 pos = {game.player.pos.x + (rand() % viewportWidth) - viewportWidth / 2, game.player.pos.y + (rand() % viewportHeight) - viewportHeight / 2};
+      if (getRegion(&game, (Int2){floorf(pos.x / TILE_SIZE), floorf(pos.y / TILE_SIZE)}) < 0) continue;
+      emitParticles(&particles, PARTICLE_SPARK, pos, Vector2Zero(), target - pool->count < 64 ? target - pool->count : 64);
+    }
+    int before = pool->count;
+
+    double startTime = now();
+    updateParticles(&particles, &game, 1.0f / 60.0f);
+    double frameT = now() - startTime;
+    updateT += frameT;
+    if (frameT > slowestT) slowestT = frameT;
+    retired += before - pool->count;
+
+    startTime = now();
+    drawParticles(&particles, &game, &renderer);
+    drawT += now() - startTime;
+  }
+
+  printf("%d particles, %d frames\n", target, frames);
+  printf("update: %.0fus average, %.0fus slowest (%.1fns per particle)\n", updateT / frames * 1000000, slowestT * 1000000, updateT / frames / target * 1e9);
+  printf("software draw: %.0fus average\n", drawT / frames * 1000000);
+  printf("retired per frame: %.0f, bounced per frame: %.0f\n", (double)retired / frames, (double)particles.bounceCount / frames);
+
+  unloadParticles(&particles);
+  unloadRenderer(&renderer);
+  return 0;
+}
@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "particles.h"
+#include "game.h"
+#include "render.h"
+#include "global.h"
+
+// Typedefs
+// The view window as one byte per cell, framed by a ring of CELL_OUTSIDE so any position clamps onto a valid entry
+#define GRID_SIZE (VIEW_SIZE + 2)
+typedef unsigned char CellGrid[GRID_SIZE * GRID_SIZE];
+typedef enum CellState {CELL_OPEN = 0, CELL_SOLID, CELL_OUTSIDE} CellState;
+
+// Local function definitions
+static void buildGrid(const GameState *game, CellGrid grid, Vector2 *origin);
+static void advance(float *restrict x, float *restrict y, float *restrict vx, float *restrict vy, float *restrict life, unsigned char *restrict cell, int count, float damping, float delta, const unsigned char *grid, Vector2 origin);
+static int collide(ParticlePool *pool, const CellGrid grid, Vector2 origin, float bounce, float delta);
+static CellState cellAt(const CellGrid grid, Vector2 origin, float x, float y);
+static float randomFloat(Particles *particles);
+
+// Constants
+static const struct {
+  float life; // Seconds, each particle gets between half and all of it
+  float drag; // Exponential, per second
+  float speed; // Launch speed in px/s, each particle gets between half and all of it
+  float spread; // Launch angle either side of the emit direction
+  float bounce; // Velocity kept off a wall
+  float size;
+  Color colour;
+} particleKinds[PARTICLE_TYPES] = {
+  {8.0f, 0.2f, 8, PI, 0.5f, 1, {200, 190, 170, 70}}, // Dust
+  {0.4f, 4.0f, 240, 0.8f, 0.6f, 1, {255, 210, 110, 255}}, // Sparks
+  {1.0f, 5.0f, 120, PI, 0.3f, 2, {70, 60, 50, 255}}, // Debris
+};
+
+bool initParticles(Particles *particles, uint seed) {
+  *particles = (Particles){0};
+  particles->rng = seed ? seed : 1;
+  for (int i = 0; i < PARTICLE_TYPES; i++) {
+    ParticlePool *pool = &particles->pools[i];
+    // Zeroed, the passes run over whole blocks of PARTICLE_LANES so the tail past count must hold harmless numbers
+    pool->x = calloc(PARTICLE_CAPACITY, sizeof(float));
+    pool->y = calloc(PARTICLE_CAPACITY, sizeof(float));
+    pool->vx = calloc(PARTICLE_CAPACITY, sizeof(float));
+    pool->vy = calloc(PARTICLE_CAPACITY, sizeof(float));
+    pool->life = calloc(PARTICLE_CAPACITY, sizeof(float));
+    pool->cell = calloc(PARTICLE_CAPACITY, 1);
+    if (!pool->x || !pool->y || !pool->vx || !pool->vy || !pool->life || !pool->cell) {
+      unloadParticles(particles);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Particles past PARTICLE_CAPACITY are dropped
+void emitParticles(Particles *particles, ParticleType type, Vector2 pos, Vector2 direction, int count) {
+  ParticlePool *pool = &particles->pools[type];
+  float angle = atan2f(direction.y, direction.x);
+  for (int i = 0; i < count && pool->count < PARTICLE_CAPACITY; i++) {
+    float launch = angle + (randomFloat(particles) * 2 - 1) * particleKinds[type].spread;
+    float speed = particleKinds[type].speed * (0.5f + randomFloat(particles) * 0.5f);
+    int j = pool->count++;
+    pool->x[j] = pos.x;
+    pool->y[j] = pos.y;
+    pool->vx[j] = cosf(launch) * speed;
+    pool->vy[j] = sinf(launch) * speed;
+    pool->life[j] = particleKinds[type].life * (0.5f + randomFloat(particles) * 0.5f);
+  }
+}
+
+// Spawns from whatever the game did since the last update, then each type goes through two passes:
+// moving everything and finding its cell, then bouncing and retiring the few that need it
+void updateParticles(Particles *particles, GameState *game, float delta) {
+  if (game->bumpCount != particles->bumpCount) {
+    emitParticles(particles, PARTICLE_SPARK, game->rawPos, game->bumpNormal, 3);
+    particles->bumpCount = game->bumpCount;
+  }
+  if (game->carveCount != particles->carveCount) {
+    Vector2 centre = {(game->lastCarve.x + 0.5f) * TILE_SIZE, (game->lastCarve.y + 0.5f) * TILE_SIZE};
+    emitParticles(particles, PARTICLE_DEBRIS, centre, Vector2Zero(), 24);
+    particles->carveCount = game->carveCount;
+  }
+
+  CellGrid grid;
+  Vector2 origin;
+  buildGrid(game, grid, &origin);
+
+  // Dust settles anywhere on screen that isn't wall
+  particles->dustDue += DUST_RATE * delta;
+  for (; particles->dustDue >= 1; particles->dustDue--) {
+    if (particles->pools[PARTICLE_DUST].count >= DUST_MAX) continue;
+    Vector2 pos = {game->player.pos.x + (randomFloat(particles) - 0.5f) * viewportWidth, game->player.pos.y + (randomFloat(particles) - 0.5f) * viewportHeight};
+    if (cellAt(grid, origin, pos.x, pos.y) != CELL_OPEN) continue;
+    emitParticles(particles, PARTICLE_DUST, pos, Vector2Zero(), 1);
+  }
+
+  for (int i = 0; i < PARTICLE_TYPES; i++) {
+    ParticlePool *pool = &particles->pools[i];
+    advance(pool->x, pool->y, pool->vx, pool->vy, pool->life, pool->cell, pool->count, expf(-particleKinds[i].drag * delta), delta, grid, origin);
+    particles->bounceCount += collide(pool, grid, origin, particleKinds[i].bounce, delta);
+  }
+}
+
+// One batch per type, dust brightens and dims with the flicker
+void drawParticles(Particles *particles, GameState *game, Renderer *renderer) {
+  beginFrame(renderer);
+    for (int i = 0; i < PARTICLE_TYPES; i++) {
+      ParticlePool *pool = &particles->pools[i];
+      Color colour = particleKinds[i].colour;
+      if (i == PARTICLE_DUST) colour.a *= game->flicker / 256.0f + 0.75f;
+      drawPoints(renderer, pool->x, pool->y, pool->count, game->globalOffset, particleKinds[i].size, colour);
+    }
+  endFrame(renderer);
+}
+
+void unloadParticles(Particles *particles) {
+  for (int i = 0; i < PARTICLE_TYPES; i++) {
+    ParticlePool *pool = &particles->pools[i];
+    free(pool->x);
+    free(pool->y);
+    free(pool->vx);
+    free(pool->vy);
+    free(pool->life);
+    free(pool->cell);
+  }
+  *particles = (Particles){0};
+}
+
+// Outside the view window the level ring holds other cells, so the grid only covers the window
+static void buildGrid(const GameState *game, CellGrid grid, Vector2 *origin) {
+  Int2 corner = {game->gridPos.x - VIEW_RADIUS - 1, game->gridPos.y - VIEW_RADIUS - 1};
+  *origin = (Vector2){corner.x, corner.y};
+  for (int y = 0; y < GRID_SIZE; y++) {
+    for (int x = 0; x < GRID_SIZE; x++) {
+      if (x == 0 || y == 0 || x == GRID_SIZE - 1 || y == GRID_SIZE - 1) {
+        grid[y * GRID_SIZE + x] = CELL_OUTSIDE;
+        continue;
+      }
+      int levelX = (corner.x + x) & LEVEL_MASK, levelY = (corner.y + y) & LEVEL_MASK;
+      grid[y * GRID_SIZE + x] = (game->world.level[levelY][levelX / 8] >> (levelX % 8)) & 1;
+    }
+  }
+}
+
+// Fixed width blocks so the compiler vectorises the maths even without a trip count it can see, only the grid
+// lookup is left scalar. The arrays are restrict parameters rather than read out of the pool so the compiler can
+// trust they don't overlap
+static void advance(float *restrict x, float *restrict y, float *restrict vx, float *restrict vy, float *restrict life, unsigned char *restrict cell, int count, float damping, float delta, const unsigned char *grid, Vector2 origin) {
+  const float inverse = 1.0f / TILE_SIZE;
+  for (int i = 0; i < count; i += PARTICLE_LANES) {
+    int index[PARTICLE_LANES];
+    for (int j = 0; j < PARTICLE_LANES; j++) {
+      vx[i + j] *= damping;
+      vy[i + j] *= damping;
+      x[i + j] += vx[i + j] * delta;
+      y[i + j] += vy[i + j] * delta;
+      life[i + j] -= delta;
+
+      float cellX = x[i + j] * inverse - origin.x, cellY = y[i + j] * inverse - origin.y;
+      cellX = cellX < 0 ? 0 : cellX > GRID_SIZE - 1 ? GRID_SIZE - 1 : cellX;
+      cellY = cellY < 0 ? 0 : cellY > GRID_SIZE - 1 ? GRID_SIZE - 1 : cellY;
+      index[j] = (int)cellY * GRID_SIZE + (int)cellX;
+    }
+    for (int j = 0; j < PARTICLE_LANES; j++) cell[i + j] = grid[index[j]];
+  }
+}
+
+// Dead particles, and ones that left the window, are replaced by the last live one since order doesn't matter.
+// One that moved into a wall steps back along whichever axis took it there and bounces off it
+static int collide(ParticlePool *pool, const CellGrid grid, Vector2 origin, float bounce, float delta) {
+  float *x = pool->x, *y = pool->y;
+  float *vx = pool->vx, *vy = pool->vy;
+  float *life = pool->life;
+  unsigned char *cell = pool->cell;
+  int bounces = 0;
+  for (int i = 0; i < pool->count; ) {
+    if (life[i] <= 0 || cell[i] == CELL_OUTSIDE) {
+      int last = --pool->count;
+      x[i] = x[last];
+      y[i] = y[last];
+      vx[i] = vx[last];
+      vy[i] = vy[last];
+      life[i] = life[last];
+      cell[i] = cell[last];
+      continue;
+    }
+
+    if (cell[i] == CELL_SOLID) {
+      float oldX = x[i] - vx[i] * delta, oldY = y[i] - vy[i] * delta;
+      if (cellAt(grid, origin, oldX, y[i]) == CELL_OPEN) {
+        x[i] = oldX;
+        vx[i] *= -bounce;
+        vy[i] *= bounce;
+      } else if (cellAt(grid, origin, x[i], oldY) == CELL_OPEN) {
+        y[i] = oldY;
+        vx[i] *= bounce;
+        vy[i] *= -bounce;
+      } else {
+        x[i] = oldX;
+        y[i] = oldY;
+        vx[i] *= -bounce;
+        vy[i] *= -bounce;
+      }
+      bounces++;
+    }
+    i++;
+  }
+  return bounces;
+}
+
+static CellState cellAt(const CellGrid grid, Vector2 origin, float x, float y) {
+  float cellX = x / TILE_SIZE - origin.x, cellY = y / TILE_SIZE - origin.y;
+  cellX = cellX < 0 ? 0 : cellX > GRID_SIZE - 1 ? GRID_SIZE - 1 : cellX;
+  cellY = cellY < 0 ? 0 : cellY > GRID_SIZE - 1 ? GRID_SIZE - 1 : cellY;
+  return grid[(int)cellY * GRID_SIZE + (int)cellX];
+}
+
+// Own xorshift so effects never disturb the game's generator
+static float randomFloat(Particles *particles) {
+  uint x = particles->rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  particles->rng = x;
+  return (x >> 8) / 16777216.0f;
+}
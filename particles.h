@@ -0,0 +1,45 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include "raylib.h"
+#include "raymath.h"
+#include "game.h"
+#include "render.h"
+#include "global.h"
+
+// Cosmetic particles, kept out of GameState so they never touch the simulation, replays or snapshots
+
+#define PARTICLE_CAPACITY 131072 // Per type, a multiple of PARTICLE_LANES
+#define PARTICLE_LANES 8 // Update passes work in blocks this wide
+#define DUST_RATE 60.0f // Dust motes spawned per second around the player
+#define DUST_MAX 1500
+
+// Typedefs
+typedef enum ParticleType {PARTICLE_DUST = 0, PARTICLE_SPARK, PARTICLE_DEBRIS, PARTICLE_TYPES} ParticleType;
+
+// Struct of arrays, each update pass streams through only the fields it needs
+typedef struct ParticlePool {
+  float *x, *y;
+  float *vx, *vy;
+  float *life;
+  unsigned char *cell; // Scratch, what each particle landed on this update
+  int count;
+} ParticlePool;
+
+typedef struct Particles {
+  ParticlePool pools[PARTICLE_TYPES];
+  uint rng;
+  uint bumpCount, carveCount; // Last seen from the game, new ones emit sparks and debris
+  float dustDue;
+  // Stats
+  uint bounceCount;
+} Particles;
+
+// Function definitions
+bool initParticles(Particles *particles, uint seed);
+void emitParticles(Particles *particles, ParticleType type, Vector2 pos, Vector2 direction, int count);
+void updateParticles(Particles *particles, GameState *game, float delta);
+void drawParticles(Particles *particles, GameState *game, Renderer *renderer);
+void unloadParticles(Particles *particles);
+
+#endif
@@ -0,0 +1,60 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "game.h"
+#include "replay.h"
+#include "tool.h"
+#include "global.h"
+
+// Headless replay: plays a recording as fast as possible from an optional start tick
+// usage: playback <file> [start tick]
+
+// Variables
+static GameState game;
+static Replay replay;
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <file> [start tick]\n", argv[0]);
+    return 1;
+  }
+  if (!loadReplay(&replay, argv[1])) {
+    fprintf(stderr, "could not load replay %s\n", argv[1]);
+    return 1;
+  }
+  uint startTick = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+
+  double startTime = now();
+  if (!seekReplay(&replay, &game, startTick)) {
+    fprintf(stderr, "tick %u is outside the recording (%u ticks)\n", startTick, replay.tickCount);
+    unloadReplay(&replay);
+    return 1;
+  }
+  double seekT = now() - startTime;
+
+  Vector2 rawIn;
+  float delta;
+  double slowestT = 0;
+  uint slowestTick = 0;
+  startTime = now();
+  while (nextTick(&replay, &rawIn, &delta)) {
+    double tickStart = now();
+    stepGame(&game, rawIn, delta);
+    double tickT = now() - tickStart;
+    if (tickT > slowestT) {
+      slowestT = tickT;
+      slowestTick = replay.tick - 1;
+    }
+  }
+  double playT = now() - startTime;
+  uint played = replay.tickCount - startTick;
+
+  printf("seed: %u\nticks: %u (%zu bytes of input, %d keyframes)\n", replay.seed, replay.tickCount, replay.length, replay.keyframeCount);
+  printf("seek to %u: %fs\nplayed %u ticks in %fs (%.0f ticks/s)\n", startTick, seekT, played, playT, played / playT);
+  printf("slowest tick: %u (%fus)\nfinal position: %.0f %.0f\n", slowestTick, slowestT * 1000000, game.player.pos.x, game.player.pos.y);
+
+  unloadReplay(&replay);
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "game.h"
+#include "tool.h"
+#include "global.h"
+
+// Reachability check: wanders headless worlds and, on every grid step, compares isReachable() for the whole window
+// against a flood fill from the player, and checks each new strip has a cell the player can walk to
+// usage: reachcheck [worlds] [steps per world], other window sizes need a rebuild, e.g. VIEW_RADIUS=40 ./build.sh
+
+// Local function definitions
+static int floodWindow(const GameState *game, bool reached[VIEW_SIZE][VIEW_SIZE]);
+static bool isOpen(const GameState *game, Int2 pos);
+
+// Variables
+static GameState game;
+
+int main(int argc, char **argv) {
+  int worlds = argc > 1 ? atoi(argv[1]) : 20;
+  long steps = argc > 2 ? atol(argv[2]) : 50000;
+  if (worlds < 1 || steps < 1) {
+    fprintf(stderr, "usage: %s [worlds] [steps per world]\n", argv[0]);
+    return 1;
+  }
+
+  long checks = 0, cells = 0, wrong = 0, strips = 0, sealed = 0, carves = 0;
+  for (int w = 0; w < worlds; w++) {
+    initWorld(&game, 0x9e3779b9u * (w + 1));
+
+    // Same wander as the batch runner
+    uint dirSeed = w * 2654435761u + 1;
+    Vector2 rawIn = Vector2Zero();
+    for (long i = 0; i < steps; i++) {
+      if (i % 97 == 0) {
+        dirSeed ^= dirSeed << 13;
+        dirSeed ^= dirSeed >> 17;
+        dirSeed ^= dirSeed << 5;
+        rawIn = (Vector2){(int)(dirSeed % 3) - 1, (int)(dirSeed / 3 % 3) - 1};
+      }
+      Int2 oldGridPos = game.gridPos;
+      stepGame(&game, rawIn, 1 / 60.0f);
+      if (game.gridPos.x == oldGridPos.x && game.gridPos.y == oldGridPos.y) continue;
+
+      bool reached[VIEW_SIZE][VIEW_SIZE];
+      floodWindow(&game, reached);
+      checks++;
+      for (int y = 0; y < VIEW_SIZE; y++) {
+        for (int x = 0; x < VIEW_SIZE; x++) {
+          Int2 pos = {game.gridPos.x - VIEW_RADIUS + x, game.gridPos.y - VIEW_RADIUS + y};
+          cells++;
+          if (isReachable(&game, pos) != reached[y][x]) wrong++;
+        }
+      }
+
+      // The strips just written sit on the edges of the window the player moved towards
+      if (!reached[VIEW_RADIUS][VIEW_RADIUS]) continue;
+      if (game.gridPos.x != oldGridPos.x) {
+        int x = game.gridPos.x > oldGridPos.x ? VIEW_SIZE - 1 : 0;
+        bool open = false;
+        for (int y = 0; y < VIEW_SIZE; y++) open = open || reached[y][x];
+        strips++;
+        sealed += !open;
+      }
+      if (game.gridPos.y != oldGridPos.y) {
+        int y = game.gridPos.y > oldGridPos.y ? VIEW_SIZE - 1 : 0;
+        bool open = false;
+        for (int x = 0; x < VIEW_SIZE; x++) open = open || reached[y][x];
+        strips++;
+        sealed += !open;
+      }
+    }
+    carves += game.carveCount;
+  }
+
+  printf("radius %d, %d worlds, %ld steps each\n", VIEW_RADIUS, worlds, steps);
+  printf("windows checked: %ld\nwrong answers: %ld of %ld cells\nsealed strips: %ld of %ld\ncarved cells: %ld\n", checks, wrong, cells, sealed, strips, carves);
+  return wrong || sealed ? 1 : 0;
+}
+
+// Breadth first over the window from the player's cell, indexed from the window's top left
+static int floodWindow(const GameState *game, bool reached[VIEW_SIZE][VIEW_SIZE]) {
+  static Int2 queue[VIEW_CELLS];
+  const Int2 dirs[4] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+  Int2 corner = {game->gridPos.x - VIEW_RADIUS, game->gridPos.y - VIEW_RADIUS};
+  memset(reached, 0, sizeof(bool) * VIEW_CELLS);
+  if (!isOpen(game, game->gridPos)) return 0;
+
+  int head = 0, tail = 0;
+  reached[VIEW_RADIUS][VIEW_RADIUS] = true;
+  queue[tail++] = (Int2){VIEW_RADIUS, VIEW_RADIUS};
+  while (head < tail) {
+    Int2 cell = queue[head++];
+    for (int i = 0; i < 4; i++) {
+      Int2 next = {cell.x + dirs[i].x, cell.y + dirs[i].y};
+      if (next.x < 0 || next.y < 0 || next.x >= VIEW_SIZE || next.y >= VIEW_SIZE || reached[next.y][next.x]) continue;
+      if (!isOpen(game, (Int2){corner.x + next.x, corner.y + next.y})) continue;
+      reached[next.y][next.x] = true;
+      queue[tail++] = next;
+    }
+  }
+  return tail;
+}
+
+static bool isOpen(const GameState *game, Int2 pos) {
+  int x = pos.x & LEVEL_MASK, y = pos.y & LEVEL_MASK;
+  return !((game->world.level[y][x / 8] >> (x % 8)) & 1);
+}
@@ -0,0 +1,376 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "rlgl.h"
+#include "render.h"
+#include "global.h"
+
+// Typedefs
+typedef struct RenderWorker {
+  Renderer *renderer;
+  int index;
+} RenderWorker;
+
+struct RenderPool {
+  pthread_t threads[RENDER_MAX_THREADS];
+  RenderWorker workers[RENDER_MAX_THREADS];
+  pthread_barrier_t start, finish;
+  bool quit;
+};
+
+// Local function definitions
+static void *runWorker(void *arg);
+static void rasterize(Renderer *renderer, int index);
+static int tileOwner(Renderer *renderer, int x, int y);
+static void fillFan(Renderer *renderer, const RenderCommand *command, int minX, int minY, int maxX, int maxY);
+static void fillCircle(Renderer *renderer, const RenderCommand *command, int minX, int minY, int maxX, int maxY);
+static void fillImage(Renderer *renderer, const RenderCommand *command, int minX, int minY, int maxX, int maxY);
+static void fillPoints(Renderer *renderer, const RenderCommand *command, int index);
+static RenderCommand *addCommand(Renderer *renderer, RenderCommandType type, Color colour, float minX, float minY, float maxX, float maxY);
+static Color blend(Color dst, Color src);
+static int wrap(int a, int b);
+
+// Software rendering runs threads - 1 workers, the calling thread rasterizes its share at endFrame()
+bool initRenderer(Renderer *renderer, RenderBackend backend, RenderTexture2D *target, int threads) {
+  *renderer = (Renderer){0};
+  renderer->backend = backend;
+  renderer->target = target;
+  if (backend == RENDER_RAYLIB) return target != NULL;
+
+  if (threads < 1) threads = 1;
+  if (threads > RENDER_MAX_THREADS) threads = RENDER_MAX_THREADS;
+  renderer->threadCount = threads;
+  renderer->pixels = calloc(viewportWidth * viewportHeight, sizeof(Color));
+  renderer->commandCapacity = 1024;
+  renderer->commands = malloc(renderer->commandCapacity * sizeof(RenderCommand));
+  renderer->vertCapacity = 4096;
+  renderer->verts = malloc(renderer->vertCapacity * sizeof(Vector2));
+  RenderPool *pool = renderer->pool = calloc(1, sizeof(RenderPool));
+  pthread_barrier_init(&pool->start, NULL, threads);
+  pthread_barrier_init(&pool->finish, NULL, threads);
+  for (int i = 1; i < threads; i++) {
+    pool->workers[i] = (RenderWorker){renderer, i};
+    pthread_create(&pool->threads[i], NULL, runWorker, &pool->workers[i]);
+  }
+  return renderer->pixels != NULL && renderer->commands != NULL && renderer->verts != NULL;
+}
+
+// Takes ownership of image
+RenderImage loadRenderImage(Renderer *renderer, Image image) {
+  RenderImage result = {0};
+  if (renderer->backend == RENDER_RAYLIB) {
+    result.texture = LoadTextureFromImage(image);
+    UnloadImage(image);
+  } else {
+    ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    result.image = image;
+  }
+  return result;
+}
+
+void unloadRenderImage(RenderImage *image) {
+  if (image->texture.id != 0) UnloadTexture(image->texture);
+  if (image->image.data != NULL) UnloadImage(image->image);
+  *image = (RenderImage){0};
+}
+
+void beginFrame(Renderer *renderer) {
+  if (renderer->backend == RENDER_RAYLIB) BeginTextureMode(*renderer->target);
+  else renderer->commandCount = renderer->vertCount = 0;
+}
+
+void clearFrame(Renderer *renderer, Color colour) {
+  if (renderer->backend == RENDER_RAYLIB) ClearBackground(colour);
+  else addCommand(renderer, RENDER_CLEAR, colour, 0, 0, viewportWidth, viewportHeight);
+}
+
+// Fans are assumed convex, which everything drawGame() draws is
+void drawFan(Renderer *renderer, const Vector2 *verts, int count, Color colour) {
+  if (renderer->backend == RENDER_RAYLIB) {
+    DrawTriangleFan((Vector2 *)verts, count, colour);
+    return;
+  }
+  if (count < 3) return;
+
+  Vector2 min = verts[0], max = verts[0];
+  for (int i = 1; i < count; i++) {
+    min = (Vector2){fminf(min.x, verts[i].x), fminf(min.y, verts[i].y)};
+    max = (Vector2){fmaxf(max.x, verts[i].x), fmaxf(max.y, verts[i].y)};
+  }
+  RenderCommand *command = addCommand(renderer, RENDER_FAN, colour, min.x, min.y, max.x, max.y);
+  if (command == NULL) return;
+  command->count = count;
+  command->first = renderer->vertCount;
+
+  if (renderer->vertCount + count > renderer->vertCapacity) {
+    while (renderer->vertCount + count > renderer->vertCapacity) renderer->vertCapacity *= 2;
+    renderer->verts = realloc(renderer->verts, renderer->vertCapacity * sizeof(Vector2));
+  }
+  memcpy(&renderer->verts[renderer->vertCount], verts, count * sizeof(Vector2));
+  renderer->vertCount += count;
+}
+
+void drawCircle(Renderer *renderer, Vector2 centre, float radius, Color colour) {
+  if (renderer->backend == RENDER_RAYLIB) {
+    DrawCircleV(centre, radius, colour);
+    return;
+  }
+  RenderCommand *command = addCommand(renderer, RENDER_CIRCLE, colour, centre.x - radius, centre.y - radius, centre.x + radius, centre.y + radius);
+  if (command == NULL) return;
+  command->pos = centre;
+  command->radius = radius;
+}
+
+// Source coords outside the image repeat, like raylib's default texture wrap
+void drawImage(Renderer *renderer, const RenderImage *image, Rectangle source, Rectangle dest) {
+  if (renderer->backend == RENDER_RAYLIB) {
+    DrawTexturePro(image->texture, source, dest, Vector2Zero(), 0.0f, WHITE);
+    return;
+  }
+  RenderCommand *command = addCommand(renderer, RENDER_IMAGE, WHITE, dest.x, dest.y, dest.x + dest.width, dest.y + dest.height);
+  if (command == NULL) return;
+  command->image = image;
+  command->source = source;
+  command->dest = dest;
+}
+
+// size x size squares all in one colour, raylib gets them as one run of quads instead of a call each
+void drawPoints(Renderer *renderer, const float *xs, const float *ys, int count, Vector2 offset, float size, Color colour) {
+  if (count < 1) return;
+  if (renderer->backend == RENDER_RAYLIB) {
+    for (int first = 0; first < count; first += 4096) {
+      int last = first + 4096 < count ? first + 4096 : count;
+      rlCheckRenderBatchLimit((last - first) * 4);
+      rlBegin(RL_QUADS);
+        rlColor4ub(colour.r, colour.g, colour.b, colour.a);
+        for (int i = first; i < last; i++) {
+          float x = xs[i] + offset.x, y = ys[i] + offset.y;
+          rlVertex2f(x, y);
+          rlVertex2f(x, y + size);
+          rlVertex2f(x + size, y + size);
+          rlVertex2f(x + size, y);
+        }
+      rlEnd();
+    }
+    return;
+  }
+
+  Vector2 min = {xs[0], ys[0]}, max = min;
+  for (int i = 1; i < count; i++) {
+    min = (Vector2){fminf(min.x, xs[i]), fminf(min.y, ys[i])};
+    max = (Vector2){fmaxf(max.x, xs[i]), fmaxf(max.y, ys[i])};
+  }
+  RenderCommand *command = addCommand(renderer, RENDER_POINTS, colour, min.x + offset.x, min.y + offset.y, max.x + offset.x + size, max.y + offset.y + size);
+  if (command == NULL) return;
+  command->xs = xs;
+  command->ys = ys;
+  command->count = count;
+  command->pos = offset;
+  command->radius = size;
+}
+
+void endFrame(Renderer *renderer) {
+  if (renderer->backend == RENDER_RAYLIB) {
+    EndTextureMode();
+    return;
+  }
+  pthread_barrier_wait(&renderer->pool->start);
+  rasterize(renderer, 0);
+  pthread_barrier_wait(&renderer->pool->finish);
+}
+
+// Borrowed view of the software framebuffer, valid until the next endFrame()
+Image frameImage(Renderer *renderer) {
+  return (Image){renderer->pixels, viewportWidth, viewportHeight, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+}
+
+void unloadRenderer(Renderer *renderer) {
+  RenderPool *pool = renderer->pool;
+  if (pool != NULL) {
+    pool->quit = true;
+    pthread_barrier_wait(&pool->start);
+    for (int i = 1; i < renderer->threadCount; i++) pthread_join(pool->threads[i], NULL);
+    pthread_barrier_destroy(&pool->start);
+    pthread_barrier_destroy(&pool->finish);
+    free(pool);
+  }
+  free(renderer->pixels);
+  free(renderer->commands);
+  free(renderer->verts);
+  *renderer = (Renderer){0};
+}
+
+static void *runWorker(void *arg) {
+  RenderWorker *worker = arg;
+  Renderer *renderer = worker->renderer;
+  RenderPool *pool = renderer->pool;
+  while (true) {
+    pthread_barrier_wait(&pool->start);
+    if (pool->quit) break;
+    rasterize(renderer, worker->index);
+    pthread_barrier_wait(&pool->finish);
+  }
+  return NULL;
+}
+
+// Tiles are dealt out round robin, each pixel belongs to one thread so commands land in order without locking.
+// Every thread walks the whole command list but only fills the tiles it owns
+static void rasterize(Renderer *renderer, int index) {
+  for (int i = 0; i < renderer->commandCount; i++) {
+    const RenderCommand *command = &renderer->commands[i];
+    if (command->type == RENDER_POINTS) {
+      fillPoints(renderer, command, index);
+      continue;
+    }
+
+    for (int tileY = command->minY / RENDER_TILE; tileY <= command->maxY / RENDER_TILE; tileY++) {
+      for (int tileX = command->minX / RENDER_TILE; tileX <= command->maxX / RENDER_TILE; tileX++) {
+        if (tileOwner(renderer, tileX * RENDER_TILE, tileY * RENDER_TILE) != index) continue;
+        int x0 = command->minX > tileX * RENDER_TILE ? command->minX : tileX * RENDER_TILE;
+        int y0 = command->minY > tileY * RENDER_TILE ? command->minY : tileY * RENDER_TILE;
+        int x1 = command->maxX < (tileX + 1) * RENDER_TILE - 1 ? command->maxX : (tileX + 1) * RENDER_TILE - 1;
+        int y1 = command->maxY < (tileY + 1) * RENDER_TILE - 1 ? command->maxY : (tileY + 1) * RENDER_TILE - 1;
+
+        switch (command->type) {
+          case RENDER_CLEAR:
+            for (int y = y0; y <= y1; y++) {
+              for (int x = x0; x <= x1; x++) renderer->pixels[y * viewportWidth + x] = command->colour;
+            }
+            break;
+          case RENDER_FAN: fillFan(renderer, command, x0, y0, x1, y1); break;
+          case RENDER_CIRCLE: fillCircle(renderer, command, x0, y0, x1, y1); break;
+          case RENDER_IMAGE: fillImage(renderer, command, x0, y0, x1, y1); break;
+          default: break;
+        }
+      }
+    }
+  }
+}
+
+static int tileOwner(Renderer *renderer, int x, int y) {
+  const int tilesX = (viewportWidth + RENDER_TILE - 1) / RENDER_TILE;
+  return ((y / RENDER_TILE) * tilesX + x / RENDER_TILE) % renderer->threadCount;
+}
+
+// Each edge bounds a row's span from one side, so rows are filled as one span between the tightest bounds
+static void fillFan(Renderer *renderer, const RenderCommand *command, int minX, int minY, int maxX, int maxY) {
+  const Vector2 *verts = &renderer->verts[command->first];
+  float area = 0;
+  for (int i = 0; i < command->count; i++) {
+    Vector2 a = verts[i], b = verts[(i + 1) % command->count];
+    area += a.x * b.y - b.x * a.y;
+  }
+  if (area == 0) return;
+  float winding = area > 0 ? 1 : -1;
+
+  for (int y = minY; y <= maxY; y++) {
+    float py = y + 0.5f;
+    int spanMin = minX, spanMax = maxX;
+    for (int i = 0; i < command->count && spanMin <= spanMax; i++) {
+      Vector2 a = verts[i], b = verts[(i + 1) % command->count];
+      // Inside is winding * ((b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x)) >= 0
+      float dy = (b.y - a.y) * winding;
+      float c = ((b.x - a.x) * (py - a.y) + (b.y - a.y) * a.x) * winding;
+      if (dy > 0) {
+        float bound = floorf(c / dy - 0.5f);
+        if (bound < spanMax) spanMax = bound < spanMin ? spanMin - 1 : bound;
+      } else if (dy < 0) {
+        float bound = ceilf(c / dy - 0.5f);
+        if (bound > spanMin) spanMin = bound > spanMax ? spanMax + 1 : bound;
+      } else if (c < 0) spanMax = spanMin - 1;
+    }
+
+    Color *row = &renderer->pixels[y * viewportWidth];
+    for (int x = spanMin; x <= spanMax; x++) row[x] = command->colour;
+  }
+}
+
+static void fillCircle(Renderer *renderer, const RenderCommand *command, int minX, int minY, int maxX, int maxY) {
+  Vector2 centre = command->pos;
+  float radiusSq = command->radius * command->radius;
+  for (int y = minY; y <= maxY; y++) {
+    float dy = y + 0.5f - centre.y;
+    if (dy * dy > radiusSq) continue;
+    float halfWidth = sqrtf(radiusSq - dy * dy);
+    int spanMin = ceilf(centre.x - halfWidth - 0.5f), spanMax = floorf(centre.x + halfWidth - 0.5f);
+    if (spanMin < minX) spanMin = minX;
+    if (spanMax > maxX) spanMax = maxX;
+
+    Color *row = &renderer->pixels[y * viewportWidth];
+    for (int x = spanMin; x <= spanMax; x++) row[x] = blend(row[x], command->colour);
+  }
+}
+
+// Nearest neighbour, alpha blended. Texel columns are the same on every row so they're looked up once per tile
+static void fillImage(Renderer *renderer, const RenderCommand *command, int minX, int minY, int maxX, int maxY) {
+  const Image *image = &command->image->image;
+  const Color *texels = image->data;
+  Rectangle source = command->source, dest = command->dest;
+  float scaleX = source.width / dest.width, scaleY = source.height / dest.height;
+
+  int columns[RENDER_TILE];
+  for (int x = minX; x <= maxX; x++) columns[x - minX] = wrap(floorf(source.x + (x + 0.5f - dest.x) * scaleX), image->width);
+
+  for (int y = minY; y <= maxY; y++) {
+    int v = wrap(floorf(source.y + (y + 0.5f - dest.y) * scaleY), image->height);
+    const Color *texelRow = &texels[v * image->width];
+    Color *row = &renderer->pixels[y * viewportWidth + minX];
+    for (int i = 0; i <= maxX - minX; i++) row[i] = blend(row[i], texelRow[columns[i]]);
+  }
+}
+
+// A point covers the pixels whose centres fall inside its square. Points are tiny and too many to revisit per tile,
+// so each thread goes through them once and keeps the pixels it owns
+static void fillPoints(Renderer *renderer, const RenderCommand *command, int index) {
+  const float *xs = command->xs, *ys = command->ys;
+  Vector2 offset = command->pos;
+  float size = command->radius;
+  for (int i = 0; i < command->count; i++) {
+    float x = xs[i] + offset.x, y = ys[i] + offset.y;
+    if (x + size <= command->minX || x >= command->maxX + 1 || y + size <= command->minY || y >= command->maxY + 1) continue;
+    int x0 = ceilf(x - 0.5f), x1 = ceilf(x + size - 0.5f) - 1;
+    int y0 = ceilf(y - 0.5f), y1 = ceilf(y + size - 0.5f) - 1;
+    if (x0 < command->minX) x0 = command->minX;
+    if (x1 > command->maxX) x1 = command->maxX;
+    if (y0 < command->minY) y0 = command->minY;
+    if (y1 > command->maxY) y1 = command->maxY;
+    for (int py = y0; py <= y1; py++) {
+      Color *row = &renderer->pixels[py * viewportWidth];
+      for (int px = x0; px <= x1; px++) {
+        if (renderer->threadCount > 1 && tileOwner(renderer, px, py) != index) continue;
+        row[px] = blend(row[px], command->colour);
+      }
+    }
+  }
+}
+
+// Bounds are clipped to the screen, commands that fall off it entirely aren't recorded
+static RenderCommand *addCommand(Renderer *renderer, RenderCommandType type, Color colour, float minX, float minY, float maxX, float maxY) {
+  if (!(minX < viewportWidth && minY < viewportHeight && maxX > 0 && maxY > 0)) return NULL;
+  RenderCommand command = {type, colour, floorf(fmaxf(minX, 0)), floorf(fmaxf(minY, 0)), ceilf(fminf(maxX, viewportWidth)) - 1, ceilf(fminf(maxY, viewportHeight)) - 1};
+  if (command.minX > command.maxX || command.minY > command.maxY) return NULL;
+
+  if (renderer->commandCount == renderer->commandCapacity) {
+    renderer->commandCapacity *= 2;
+    renderer->commands = realloc(renderer->commands, renderer->commandCapacity * sizeof(RenderCommand));
+  }
+  renderer->commands[renderer->commandCount] = command;
+  return &renderer->commands[renderer->commandCount++];
+}
+
+static Color blend(Color dst, Color src) {
+  if (src.a == 255) return src;
+  if (src.a == 0) return dst;
+  int a = src.a;
+  return (Color){(src.r * a + dst.r * (255 - a)) / 255, (src.g * a + dst.g * (255 - a)) / 255, (src.b * a + dst.b * (255 - a)) / 255, 255};
+}
+
+static int wrap(int a, int b) {
+  int r = a % b;
+  return r < 0 ? r + b : r;
+}
@@ -0,0 +1,67 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "raylib.h"
+#include "raymath.h"
+#include "global.h"
+
+// Drawing goes through a Renderer so the same frame can be drawn by raylib or rasterized on the CPU
+
+#define RENDER_TILE 64 // Side of the screen tiles software rendering splits between threads
+#define RENDER_MAX_THREADS 64
+
+// Typedefs
+typedef enum RenderBackend {RENDER_RAYLIB = 0, RENDER_SOFTWARE} RenderBackend;
+
+typedef enum RenderCommandType {RENDER_CLEAR = 0, RENDER_FAN, RENDER_CIRCLE, RENDER_IMAGE, RENDER_POINTS} RenderCommandType;
+
+// Texture for raylib, the RGBA pixels stay on the CPU for software rendering
+typedef struct RenderImage {
+  Texture2D texture;
+  Image image;
+} RenderImage;
+
+typedef struct RenderCommand {
+  RenderCommandType type;
+  Color colour;
+  int minX, minY, maxX, maxY; // Pixel bounds, inclusive
+  int count;
+  int first; // Fans, index of their first vertex in the renderer's vertex buffer
+  Vector2 pos; // Circle centre, or the offset of points
+  float radius;
+  const RenderImage *image;
+  Rectangle source, dest;
+  const float *xs, *ys; // Points, borrowed until endFrame()
+} RenderCommand;
+
+typedef struct RenderPool RenderPool;
+
+typedef struct Renderer {
+  RenderBackend backend;
+  RenderTexture2D *target; // Raylib only
+
+  // Software only, commands are recorded through the frame and rasterized at endFrame()
+  Color *pixels;
+  RenderCommand *commands;
+  int commandCount, commandCapacity;
+  Vector2 *verts; // Fan vertices for the frame, so fans of any size fit in a command
+  int vertCount, vertCapacity;
+  int threadCount;
+  RenderPool *pool;
+} Renderer;
+
+// Function definitions
+bool initRenderer(Renderer *renderer, RenderBackend backend, RenderTexture2D *target, int threads);
+RenderImage loadRenderImage(Renderer *renderer, Image image);
+void unloadRenderImage(RenderImage *image);
+void beginFrame(Renderer *renderer);
+void clearFrame(Renderer *renderer, Color colour);
+void drawFan(Renderer *renderer, const Vector2 *verts, int count, Color colour);
+void drawCircle(Renderer *renderer, Vector2 centre, float radius, Color colour);
+void drawImage(Renderer *renderer, const RenderImage *image, Rectangle source, Rectangle dest);
+void drawPoints(Renderer *renderer, const float *xs, const float *ys, int count, Vector2 offset, float size, Color colour);
+void endFrame(Renderer *renderer);
+Image frameImage(Renderer *renderer);
+void unloadRenderer(Renderer *renderer);
+
+#endif
@@ -0,0 +1,268 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "replay.h"
+#include "game.h"
+#include "store.h"
+#include "global.h"
+
+// Local function definitions
+static void pushByte(Replay *replay, unsigned char byte);
+static void addKeyframe(Replay *replay, const GameState *game);
+static void writeKeyframe(const ReplayKeyframe *keyframe, FILE *file);
+static bool readKeyframe(ReplayKeyframe *keyframe, FILE *file);
+
+// Constants
+static const char replayMagic[4] = {'C', 'J', 'R', 'P'};
+
+void beginRecording(Replay *replay, uint seed) {
+  unloadReplay(replay);
+  replay->seed = seed;
+}
+
+// Keeps the on-disk contents of every chunk the session has used from its world file. Must run before the store
+// is saved, which writes over them
+void recordStore(Replay *replay, const WorldStore *store) {
+  free(replay->chunkCoords);
+  free(replay->chunks);
+  replay->hasStore = true;
+  replay->chunkCount = 0;
+  replay->chunkCoords = malloc(store->count * 2 * sizeof(int32_t) + 1);
+  replay->chunks = malloc((size_t)store->count * STORE_PAGE_SIZE + 1);
+  for (int i = 0; i < store->capacity; i++) {
+    const StoreChunk *chunk = &store->chunks[i];
+    if (!chunk->used || !chunk->touched || chunk->page < 0) continue;
+    replay->chunkCoords[replay->chunkCount * 2] = chunk->x;
+    replay->chunkCoords[replay->chunkCount * 2 + 1] = chunk->y;
+    memcpy(replay->chunks + (size_t)replay->chunkCount * STORE_PAGE_SIZE, store->map + STORE_HEADER_SIZE + (size_t)chunk->page * STORE_PAGE_SIZE, STORE_PAGE_SIZE);
+    replay->chunkCount++;
+  }
+}
+
+// Appends one tick and returns the quantised delta the caller must step with so playback matches
+float recordTick(Replay *replay, const GameState *game, Vector2 rawIn, float delta) {
+  int deltaUs = (int)(delta * 1000000.0f + 0.5f);
+  if (deltaUs < 0) deltaUs = 0;
+  if (deltaUs > REPLAY_MAX_DELTA_US) deltaUs = REPLAY_MAX_DELTA_US;
+
+  if (replay->tickCount % REPLAY_KEYFRAME_INTERVAL == 0) addKeyframe(replay, game);
+
+  int change = deltaUs - replay->lastDeltaUs;
+  uint zigzag = change < 0 ? ((uint)-change << 1) - 1 : (uint)change << 1;
+  uint value = zigzag << 4 | packInput(rawIn);
+  while (value >= 0x80) {
+    pushByte(replay, (value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  pushByte(replay, value);
+
+  replay->lastDeltaUs = deltaUs;
+  replay->tickCount++;
+  return deltaUs / 1000000.0f;
+}
+
+bool saveReplay(const Replay *replay, const char *fileName) {
+  FILE *file = fopen(fileName, "wb");
+  if (file == NULL) return false;
+
+  uint32_t header[7] = {REPLAY_VERSION, LEVEL_SIZE, replay->seed, replay->tickCount, replay->keyframeCount, replay->hasStore, replay->chunkCount};
+  uint64_t length = replay->length;
+  fwrite(replayMagic, 1, sizeof(replayMagic), file);
+  fwrite(header, sizeof(header), 1, file);
+  fwrite(&length, sizeof(length), 1, file);
+  for (int i = 0; i < replay->keyframeCount; i++) writeKeyframe(&replay->keyframes[i], file);
+  fwrite(replay->data, 1, replay->length, file);
+  fwrite(replay->chunkCoords, sizeof(int32_t), replay->chunkCount * 2, file);
+  fwrite(replay->chunks, STORE_PAGE_SIZE, replay->chunkCount, file);
+
+  bool ok = !ferror(file);
+  return fclose(file) == 0 && ok;
+}
+
+// Keyframes hold the whole level ring, so replays only load in builds with the same LEVEL_SIZE
+bool loadReplay(Replay *replay, const char *fileName) {
+  unloadReplay(replay);
+  FILE *file = fopen(fileName, "rb");
+  if (file == NULL) return false;
+
+  char magic[4];
+  uint32_t header[7];
+  uint64_t length;
+  bool ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, replayMagic, sizeof(magic)) == 0
+    && fread(header, sizeof(header), 1, file) == 1 && header[0] == REPLAY_VERSION && header[1] == LEVEL_SIZE
+    && fread(&length, sizeof(length), 1, file) == 1;
+
+  if (ok) {
+    replay->seed = header[2];
+    replay->tickCount = header[3];
+    replay->keyframeCount = replay->keyframeCapacity = header[4];
+    replay->keyframes = malloc(replay->keyframeCount * sizeof(ReplayKeyframe));
+    replay->length = replay->capacity = length;
+    replay->data = malloc(length);
+    replay->hasStore = header[5];
+    replay->chunkCount = header[6];
+    replay->chunkCoords = malloc((size_t)replay->chunkCount * 2 * sizeof(int32_t) + 1);
+    replay->chunks = malloc((size_t)replay->chunkCount * STORE_PAGE_SIZE + 1);
+    ok = (replay->keyframes != NULL || replay->keyframeCount == 0) && (replay->data != NULL || length == 0)
+      && replay->chunkCoords != NULL && replay->chunks != NULL;
+  }
+  for (int i = 0; ok && i < replay->keyframeCount; i++) {
+    ok = readKeyframe(&replay->keyframes[i], file) && replay->keyframes[i].offset <= length;
+  }
+  if (ok) ok = fread(replay->data, 1, length, file) == length;
+  if (ok) ok = fread(replay->chunkCoords, sizeof(int32_t), replay->chunkCount * 2, file) == (size_t)replay->chunkCount * 2
+    && fread(replay->chunks, STORE_PAGE_SIZE, replay->chunkCount, file) == (size_t)replay->chunkCount;
+
+  fclose(file);
+  if (!ok) unloadReplay(replay);
+  return ok;
+}
+
+// Decodes the input for the tick under the cursor, false once the recording runs out
+bool nextTick(Replay *replay, Vector2 *rawIn, float *delta) {
+  if (replay->tick >= replay->tickCount) return false;
+
+  uint value = 0;
+  int shift = 0;
+  while (replay->readPos < replay->length) {
+    unsigned char byte = replay->data[replay->readPos++];
+    value |= (uint)(byte & 0x7f) << shift;
+    shift += 7;
+    if (!(byte & 0x80)) break;
+  }
+
+  uint zigzag = value >> 4;
+  int change = zigzag & 1 ? -(int)((zigzag + 1) >> 1) : (int)(zigzag >> 1);
+  replay->readDeltaUs += change;
+  replay->tick++;
+
+  *rawIn = unpackInput(value & 0xf);
+  *delta = replay->readDeltaUs / 1000000.0f;
+  return true;
+}
+
+// Restores the closest keyframe at or before tick and steps the rest of the way. Sessions on a world file restart
+// from the first keyframe against a freshly rebuilt store
+bool seekReplay(Replay *replay, GameState *game, uint tick) {
+  if (replay->keyframeCount == 0 || tick > replay->tickCount) return false;
+
+  int lo = 0, hi = replay->hasStore ? 0 : replay->keyframeCount - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (replay->keyframes[mid].tick <= tick) lo = mid;
+    else hi = mid - 1;
+  }
+  const ReplayKeyframe *keyframe = &replay->keyframes[lo];
+
+  game->world = keyframe->world;
+  game->rawPos = keyframe->rawPos;
+  game->rng = keyframe->rng;
+  game->moveRng = keyframe->moveRng;
+  game->paused = keyframe->paused;
+  game->stripCount = keyframe->stripCount;
+  game->carveCount = keyframe->carveCount;
+  game->bumpCount = keyframe->bumpCount;
+  game->lastCarve = keyframe->lastCarve;
+  game->bumpNormal = keyframe->bumpNormal;
+  settlePlayer(game);
+  rebuildReach(game);
+  if (replay->hasStore) {
+    if (replay->store.chunks != NULL) closeWorldStore(&replay->store);
+    openWorldStore(&replay->store, NULL);
+    for (int i = 0; i < replay->chunkCount; i++) {
+      storeLoadChunk(&replay->store, replay->chunkCoords[i * 2], replay->chunkCoords[i * 2 + 1], replay->chunks + (size_t)i * STORE_PAGE_SIZE);
+    }
+    attachStore(game, &replay->store);
+  } else game->store = NULL;
+
+  replay->tick = keyframe->tick;
+  replay->readPos = keyframe->offset;
+  replay->readDeltaUs = keyframe->deltaUs;
+
+  Vector2 rawIn;
+  float delta;
+  while (replay->tick < tick && nextTick(replay, &rawIn, &delta)) {
+    stepGame(game, rawIn, delta);
+  }
+  return true;
+}
+
+void unloadReplay(Replay *replay) {
+  free(replay->data);
+  free(replay->keyframes);
+  free(replay->chunkCoords);
+  free(replay->chunks);
+  if (replay->store.chunks != NULL) closeWorldStore(&replay->store);
+  *replay = (Replay){0};
+}
+
+static void pushByte(Replay *replay, unsigned char byte) {
+  if (replay->length == replay->capacity) {
+    replay->capacity = replay->capacity ? replay->capacity * 2 : 4096;
+    replay->data = realloc(replay->data, replay->capacity);
+  }
+  replay->data[replay->length++] = byte;
+}
+
+static void addKeyframe(Replay *replay, const GameState *game) {
+  if (replay->keyframeCount == replay->keyframeCapacity) {
+    replay->keyframeCapacity = replay->keyframeCapacity ? replay->keyframeCapacity * 2 : 16;
+    replay->keyframes = realloc(replay->keyframes, replay->keyframeCapacity * sizeof(ReplayKeyframe));
+  }
+  ReplayKeyframe *keyframe = &replay->keyframes[replay->keyframeCount++];
+  keyframe->tick = replay->tickCount;
+  keyframe->offset = replay->length;
+  keyframe->deltaUs = replay->lastDeltaUs;
+  keyframe->world = game->world;
+  keyframe->rawPos = game->rawPos;
+  keyframe->rng = game->rng;
+  keyframe->moveRng = game->moveRng;
+  keyframe->paused = game->paused;
+  keyframe->stripCount = game->stripCount;
+  keyframe->carveCount = game->carveCount;
+  keyframe->bumpCount = game->bumpCount;
+  keyframe->lastCarve = game->lastCarve;
+  keyframe->bumpNormal = game->bumpNormal;
+}
+
+// Fixed width fields in file order, the level ring is written as is
+static void writeKeyframe(const ReplayKeyframe *keyframe, FILE *file) {
+  uint32_t tick = keyframe->tick;
+  uint64_t offset = keyframe->offset;
+  int32_t deltaUs = keyframe->deltaUs;
+  float pos[4] = {keyframe->rawPos.x, keyframe->rawPos.y, keyframe->bumpNormal.x, keyframe->bumpNormal.y};
+  uint32_t counters[8] = {keyframe->rng, keyframe->moveRng, keyframe->paused, keyframe->stripCount, keyframe->carveCount, keyframe->bumpCount, keyframe->lastCarve.x, keyframe->lastCarve.y};
+  fwrite(&tick, sizeof(tick), 1, file);
+  fwrite(&offset, sizeof(offset), 1, file);
+  fwrite(&deltaUs, sizeof(deltaUs), 1, file);
+  fwrite(pos, sizeof(pos), 1, file);
+  fwrite(counters, sizeof(counters), 1, file);
+  fwrite(&keyframe->world, sizeof(WorldData), 1, file);
+}
+
+static bool readKeyframe(ReplayKeyframe *keyframe, FILE *file) {
+  uint32_t tick;
+  uint64_t offset;
+  int32_t deltaUs;
+  float pos[4];
+  uint32_t counters[8];
+  bool ok = fread(&tick, sizeof(tick), 1, file) == 1 && fread(&offset, sizeof(offset), 1, file) == 1
+    && fread(&deltaUs, sizeof(deltaUs), 1, file) == 1 && fread(pos, sizeof(pos), 1, file) == 1
+    && fread(counters, sizeof(counters), 1, file) == 1 && fread(&keyframe->world, sizeof(WorldData), 1, file) == 1;
+  keyframe->tick = tick;
+  keyframe->offset = offset;
+  keyframe->deltaUs = deltaUs;
+  keyframe->rawPos = (Vector2){pos[0], pos[1]};
+  keyframe->bumpNormal = (Vector2){pos[2], pos[3]};
+  keyframe->rng = counters[0];
+  keyframe->moveRng = counters[1];
+  keyframe->paused = counters[2];
+  keyframe->stripCount = counters[3];
+  keyframe->carveCount = counters[4];
+  keyframe->bumpCount = counters[5];
+  keyframe->lastCarve = (Int2){(int32_t)counters[6], (int32_t)counters[7]};
+  return ok;
+}
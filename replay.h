@@ -0,0 +1,68 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "game.h"
+#include "store.h"
+#include "global.h"
+
+#define REPLAY_VERSION 4
+#define REPLAY_KEYFRAME_INTERVAL 1800 // Ticks between state keyframes, 30s at 60fps
+#define REPLAY_MAX_DELTA_US 1000000 // Longer frames are clamped so they fit the encoding
+
+// Typedefs
+typedef struct ReplayKeyframe {
+  uint tick;
+  size_t offset; // Byte offset of this tick in the input stream
+  int deltaUs; // Delta of the tick before, the stream is delta encoded against it
+
+  // Only what the simulation can't derive, the player's cell and the reach labels are rebuilt on seek
+  WorldData world;
+  Vector2 rawPos;
+  uint rng, moveRng;
+  bool paused;
+  uint stripCount, carveCount, bumpCount;
+  Int2 lastCarve;
+  Vector2 bumpNormal;
+} ReplayKeyframe;
+
+typedef struct Replay {
+  uint seed;
+  uint tickCount;
+
+  // Input stream, one varint per tick: zigzag(delta change in us) << 4 | key bits
+  unsigned char *data;
+  size_t length, capacity;
+  int lastDeltaUs;
+
+  ReplayKeyframe *keyframes;
+  int keyframeCount, keyframeCapacity;
+
+  // Sessions on a world file also keep the chunks they used from it, as they were on disk, and play back against
+  // a store rebuilt from them. The store's later contents depend on every tick before, so seeks replay from the start
+  bool hasStore;
+  int chunkCount;
+  int32_t *chunkCoords; // Chunk x, y pairs
+  unsigned char *chunks; // STORE_PAGE_SIZE bytes per chunk
+  WorldStore store;
+
+  // Playback cursor
+  uint tick;
+  size_t readPos;
+  int readDeltaUs;
+} Replay;
+
+// Function definitions
+void beginRecording(Replay *replay, uint seed);
+float recordTick(Replay *replay, const GameState *game, Vector2 rawIn, float delta);
+void recordStore(Replay *replay, const WorldStore *store);
+bool saveReplay(const Replay *replay, const char *fileName);
+bool loadReplay(Replay *replay, const char *fileName);
+bool nextTick(Replay *replay, Vector2 *rawIn, float *delta);
+bool seekReplay(Replay *replay, GameState *game, uint tick);
+void unloadReplay(Replay *replay);
+
+#endif
@@ -0,0 +1,63 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "game.h"
+#include "net.h"
+#include "tool.h"
+#include "global.h"
+
+// Headless authoritative server, ticks at 60Hz and prints traffic every few seconds
+// usage: server [port]
+
+// Local function definitions
+static void sleepUntil(double time);
+
+// Variables
+static NetServer server;
+
+int main(int argc, char **argv) {
+  int port = argc > 1 ? atoi(argv[1]) : NET_PORT;
+  if (!startServer(&server, port)) {
+    fprintf(stderr, "could not listen on port %d\n", port);
+    return 1;
+  }
+  printf("listening on %d\n", server.port);
+
+  const double period = 1.0 / 60.0;
+  double nextTick = now(), nextReport = nextTick + 5.0;
+  double slowestT = 0;
+  uint64_t lastIn = 0, lastOut = 0;
+  while (true) {
+    double startTime = now();
+    serverTick(&server, startTime);
+    double tickT = now() - startTime;
+    if (tickT > slowestT) slowestT = tickT;
+
+    if (startTime >= nextReport) {
+      int players = 0;
+      for (int i = 0; i < NET_MAX_PLAYERS; i++) players += server.slots[i].active;
+      printf("tick %u: %d players, %.1f KB/s in, %.1f KB/s out, slowest tick %.0fus\n", server.tick, players, (server.bytesIn - lastIn) / 5.0 / 1024, (server.bytesOut - lastOut) / 5.0 / 1024, slowestT * 1000000);
+      fflush(stdout);
+      lastIn = server.bytesIn;
+      lastOut = server.bytesOut;
+      slowestT = 0;
+      nextReport += 5.0;
+    }
+
+    nextTick += period;
+    sleepUntil(nextTick);
+  }
+
+  stopServer(&server);
+  return 0;
+}
+
+static void sleepUntil(double time) {
+  double wait = time - now();
+  if (wait <= 0) return;
+  struct timespec ts = {(time_t)wait, (long)((wait - (time_t)wait) * 1e9)};
+  nanosleep(&ts, NULL);
+}
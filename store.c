@@ -0,0 +1,266 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "store.h"
+#include "game.h"
+#include "global.h"
+
+// Local function definitions
+static StoreChunk *findChunk(WorldStore *store, int x, int y, bool create);
+static void growChunks(WorldStore *store, int capacity);
+static uint hashChunk(int x, int y);
+static uint slotOf(uint64_t offset);
+
+// Constants
+static const char storeMagic[4] = {'C', 'J', 'W', 'D'};
+
+// Maps an existing world file, or starts an empty one if the file is new. Only the index is read up front,
+// chunk pages are faulted in by the kernel as the player walks into them. A NULL fileName keeps the store in memory
+bool openWorldStore(WorldStore *store, const char *fileName) {
+  *store = (WorldStore){0};
+  store->fd = -1;
+  struct stat info = {0};
+  if (fileName != NULL) {
+    store->fd = open(fileName, O_RDWR | O_CREAT, 0644);
+    if (store->fd < 0 || fstat(store->fd, &info) != 0) {
+      closeWorldStore(store);
+      return false;
+    }
+  }
+
+  if (info.st_size == 0) {
+    memcpy(store->header.magic, storeMagic, sizeof(storeMagic));
+    store->header.version = STORE_VERSION;
+    store->header.pageSize = STORE_PAGE_SIZE;
+    store->header.indexOffset = STORE_HEADER_SIZE;
+    growChunks(store, 1024);
+    // An empty but valid world, so a save cut short never leaves a file that won't open
+    if (store->fd >= 0 && pwrite(store->fd, &store->header, sizeof(StoreHeader), 0) != sizeof(StoreHeader)) {
+      closeWorldStore(store);
+      return false;
+    }
+    return true;
+  }
+
+  store->mapLength = info.st_size;
+  store->map = mmap(NULL, store->mapLength, PROT_READ, MAP_SHARED, store->fd, 0);
+  if (store->map == MAP_FAILED) {
+    store->map = NULL;
+    closeWorldStore(store);
+    return false;
+  }
+
+  if (store->mapLength >= STORE_HEADER_SIZE) memcpy(&store->header, store->map, sizeof(StoreHeader));
+  const StoreHeader *header = &store->header;
+  if (store->mapLength < STORE_HEADER_SIZE || memcmp(header->magic, storeMagic, sizeof(storeMagic)) != 0
+      || header->version != STORE_VERSION || header->pageSize != STORE_PAGE_SIZE
+      || header->indexOffset < STORE_HEADER_SIZE || header->indexOffset > store->mapLength
+      || (store->mapLength - header->indexOffset) / STORE_INDEX_ENTRY < header->pageCount) {
+    closeWorldStore(store);
+    return false;
+  }
+
+  int capacity = 1024;
+  while (capacity < (int)header->pageCount * 2) capacity *= 2;
+  growChunks(store, capacity);
+
+  const int32_t *index = (const int32_t *)(store->map + header->indexOffset);
+  for (uint i = 0; i < header->pageCount; i++) {
+    if (index[i * 3 + 2] < 0 || STORE_HEADER_SIZE + ((uint64_t)index[i * 3 + 2] + 1) * STORE_PAGE_SIZE > store->mapLength) {
+      closeWorldStore(store);
+      return false;
+    }
+    StoreChunk *chunk = findChunk(store, index[i * 3], index[i * 3 + 1], true);
+    chunk->page = index[i * 3 + 2];
+    chunk->data = store->map + STORE_HEADER_SIZE + (size_t)chunk->page * STORE_PAGE_SIZE;
+  }
+  return true;
+}
+
+// Looks up a cell, false if it has never been generated
+bool storeRead(WorldStore *store, Int2 pos, bool *solid) {
+  StoreChunk *chunk = findChunk(store, pos.x >> STORE_CHUNK_SHIFT, pos.y >> STORE_CHUNK_SHIFT, false);
+  if (chunk == NULL) return false;
+  chunk->touched = true;
+
+  int bit = (pos.y & (STORE_CHUNK_SIZE - 1)) * STORE_CHUNK_SIZE + (pos.x & (STORE_CHUNK_SIZE - 1));
+  if (!((chunk->data[STORE_CHUNK_BYTES + bit / 8] >> (bit % 8)) & 1)) return false;
+  *solid = (chunk->data[bit / 8] >> (bit % 8)) & 1;
+  return true;
+}
+
+// Chunks are copied out of the mapping on their first change and written back on the next save
+void storeWrite(WorldStore *store, Int2 pos, bool solid) {
+  StoreChunk *chunk = findChunk(store, pos.x >> STORE_CHUNK_SHIFT, pos.y >> STORE_CHUNK_SHIFT, true);
+  int bit = (pos.y & (STORE_CHUNK_SIZE - 1)) * STORE_CHUNK_SIZE + (pos.x & (STORE_CHUNK_SIZE - 1));
+  unsigned char mask = 1 << (bit % 8);
+  chunk->touched = true;
+
+  if (chunk->data != NULL && (chunk->data[STORE_CHUNK_BYTES + bit / 8] & mask) && ((chunk->data[bit / 8] & mask) != 0) == solid) return;
+
+  if (!chunk->owned) {
+    unsigned char *data = calloc(1, STORE_PAGE_SIZE);
+    if (chunk->data != NULL) memcpy(data, chunk->data, STORE_PAGE_SIZE);
+    chunk->data = data;
+    chunk->owned = true;
+  }
+  chunk->dirty = true;
+  chunk->data[STORE_CHUNK_BYTES + bit / 8] |= mask;
+  chunk->data[bit / 8] = (chunk->data[bit / 8] & ~mask) | (solid ? mask : 0);
+}
+
+// Adds a whole chunk page as if its cells had been generated, for stores rebuilt from a replay
+void storeLoadChunk(WorldStore *store, int x, int y, const unsigned char *page) {
+  StoreChunk *chunk = findChunk(store, x, y, true);
+  if (!chunk->owned) {
+    chunk->data = malloc(STORE_PAGE_SIZE);
+    chunk->owned = true;
+  }
+  memcpy(chunk->data, page, STORE_PAGE_SIZE);
+}
+
+// Copy on write: dirty chunks and the new index go to slots the current header doesn't reach, and only once they
+// are synced is the header pointed at them. A crash at any point leaves the old world or the new one, and a failed
+// save leaves the store as it was so it can be tried again
+bool saveWorldStore(WorldStore *store, const GameState *game) {
+  if (store->fd < 0) return false;
+  StoreHeader next = store->header;
+
+  // Enough slots for everything the current header reaches plus everything this save writes
+  uint oldIndex = slotOf(next.indexOffset);
+  uint oldIndexEnd = slotOf(next.indexOffset + (uint64_t)next.pageCount * STORE_INDEX_ENTRY + STORE_PAGE_SIZE - 1);
+  uint slotCount = oldIndexEnd;
+  next.pageCount = 0;
+  for (int i = 0; i < store->capacity; i++) {
+    const StoreChunk *chunk = &store->chunks[i];
+    if (!chunk->used) continue;
+    if (chunk->page >= 0 && (uint)chunk->page >= slotCount) slotCount = chunk->page + 1;
+    slotCount += chunk->dirty;
+    next.pageCount += chunk->page >= 0 || chunk->dirty;
+  }
+  size_t indexLength = (size_t)next.pageCount * STORE_INDEX_ENTRY;
+  uint indexSlots = (indexLength + STORE_PAGE_SIZE - 1) / STORE_PAGE_SIZE;
+  slotCount += indexSlots;
+
+  bool *used = calloc(slotCount, sizeof(bool));
+  int *pages = malloc(store->capacity * sizeof(int));
+  for (uint slot = oldIndex; slot < oldIndexEnd; slot++) used[slot] = true;
+  for (int i = 0; i < store->capacity; i++) {
+    if (store->chunks[i].used && store->chunks[i].page >= 0) used[store->chunks[i].page] = true;
+  }
+
+  bool ok = true;
+  uint slot = 0;
+  for (int i = 0; i < store->capacity; i++) {
+    StoreChunk *chunk = &store->chunks[i];
+    pages[i] = chunk->used ? chunk->page : -1;
+    if (!chunk->used || !chunk->dirty) continue;
+    while (used[slot]) slot++;
+    used[slot] = true;
+    pages[i] = slot;
+    ok = ok && pwrite(store->fd, chunk->data, STORE_PAGE_SIZE, STORE_HEADER_SIZE + (off_t)slot * STORE_PAGE_SIZE) == STORE_PAGE_SIZE;
+  }
+
+  // The index takes the first free run long enough for it
+  uint start = 0;
+  for (uint length = 0; length < indexSlots; start++) length = used[start] ? 0 : length + 1;
+  start -= indexSlots;
+  for (uint i = start; i < start + indexSlots; i++) used[i] = true;
+  int32_t *index = malloc(indexLength ? indexLength : 1);
+  int entry = 0;
+  for (int i = 0; i < store->capacity; i++) {
+    if (pages[i] < 0) continue;
+    index[entry * 3] = store->chunks[i].x;
+    index[entry * 3 + 1] = store->chunks[i].y;
+    index[entry * 3 + 2] = pages[i];
+    entry++;
+  }
+  next.indexOffset = STORE_HEADER_SIZE + (uint64_t)start * STORE_PAGE_SIZE;
+  ok = ok && pwrite(store->fd, index, indexLength, next.indexOffset) == (ssize_t)indexLength;
+  free(index);
+
+  // Nothing either header reaches lies past the last used slot
+  uint end = slotCount;
+  while (end > 0 && !used[end - 1]) end--;
+  off_t length = STORE_HEADER_SIZE + (off_t)end * STORE_PAGE_SIZE;
+  if (start + indexSlots == end) length = next.indexOffset + indexLength;
+  ok = ok && ftruncate(store->fd, length) == 0 && fsync(store->fd) == 0;
+
+  next.hasPlayer = 1;
+  next.rng = game->rng;
+  next.playerX = game->rawPos.x;
+  next.playerY = game->rawPos.y;
+  ok = ok && pwrite(store->fd, &next, sizeof(StoreHeader), 0) == sizeof(StoreHeader) && fsync(store->fd) == 0;
+  if (ok) {
+    store->header = next;
+    for (int i = 0; i < store->capacity; i++) {
+      if (!store->chunks[i].used) continue;
+      store->chunks[i].page = pages[i];
+      store->chunks[i].dirty = false;
+    }
+  }
+  free(pages);
+  free(used);
+  return ok;
+}
+
+void closeWorldStore(WorldStore *store) {
+  for (int i = 0; i < store->capacity; i++) {
+    if (store->chunks[i].owned) free(store->chunks[i].data);
+  }
+  free(store->chunks);
+  if (store->map != NULL) munmap(store->map, store->mapLength);
+  if (store->fd >= 0) close(store->fd);
+  *store = (WorldStore){0};
+  store->fd = -1;
+}
+
+static StoreChunk *findChunk(WorldStore *store, int x, int y, bool create) {
+  if (store->last != NULL && store->last->x == x && store->last->y == y) return store->last;
+  if (create && (store->count + 1) * 2 > store->capacity) growChunks(store, store->capacity * 2);
+
+  uint mask = store->capacity - 1;
+  for (uint i = hashChunk(x, y) & mask; ; i = (i + 1) & mask) {
+    StoreChunk *chunk = &store->chunks[i];
+    if (!chunk->used) {
+      if (!create) return NULL;
+      *chunk = (StoreChunk){.x = x, .y = y, .page = -1, .used = true};
+      store->count++;
+      return store->last = chunk;
+    }
+    if (chunk->x == x && chunk->y == y) return store->last = chunk;
+  }
+}
+
+static void growChunks(WorldStore *store, int capacity) {
+  StoreChunk *old = store->chunks;
+  int oldCapacity = store->capacity;
+
+  store->chunks = calloc(capacity, sizeof(StoreChunk));
+  store->capacity = capacity;
+  store->last = NULL;
+  for (int i = 0; i < oldCapacity; i++) {
+    if (!old[i].used) continue;
+    uint mask = capacity - 1;
+    uint j = hashChunk(old[i].x, old[i].y) & mask;
+    while (store->chunks[j].used) j = (j + 1) & mask;
+    store->chunks[j] = old[i];
+  }
+  free(old);
+}
+
+static uint hashChunk(int x, int y) {
+  return (uint)x * 73856093u ^ (uint)y * 19349663u;
+}
+
+static uint slotOf(uint64_t offset) {
+  return (offset - STORE_HEADER_SIZE) / STORE_PAGE_SIZE;
+}
@@ -0,0 +1,63 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "game.h"
+#include "global.h"
+
+// On-disk world: a header page, then fixed-size slots holding chunk pages and an index of chunk coords and slot.
+// Saves never write over a slot the current header reaches, and rewrite the header last
+
+#define STORE_VERSION 2
+#define STORE_CHUNK_SHIFT 5
+#define STORE_CHUNK_SIZE (1 << STORE_CHUNK_SHIFT) // Cells along each side of a chunk
+#define STORE_CHUNK_BYTES (STORE_CHUNK_SIZE * STORE_CHUNK_SIZE / 8)
+#define STORE_PAGE_SIZE (STORE_CHUNK_BYTES * 2) // Solid bits, then known bits
+#define STORE_HEADER_SIZE 4096
+#define STORE_INDEX_ENTRY (3 * sizeof(int32_t)) // Chunk x, chunk y, slot
+
+// Typedefs
+typedef struct StoreHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t pageSize;
+  uint32_t pageCount; // Chunks in the index
+  uint64_t indexOffset;
+  // Where to resume from
+  uint32_t hasPlayer;
+  uint32_t rng;
+  float playerX, playerY;
+} StoreHeader;
+
+typedef struct StoreChunk {
+  int x, y;
+  int page; // Slot in the file, -1 until the chunk has been saved
+  unsigned char *data; // Points into the mapping until the chunk is first written to
+  bool used, owned, dirty;
+  bool touched; // Read or written since the store was opened
+} StoreChunk;
+
+struct WorldStore {
+  int fd;
+  unsigned char *map;
+  size_t mapLength;
+  StoreHeader header;
+
+  // Open addressed table of chunks keyed by chunk coords
+  StoreChunk *chunks;
+  int capacity, count;
+  StoreChunk *last; // Most recent lookup, strips usually stay inside one chunk
+};
+
+// Function definitions
+bool openWorldStore(WorldStore *store, const char *fileName);
+bool storeRead(WorldStore *store, Int2 pos, bool *solid);
+void storeWrite(WorldStore *store, Int2 pos, bool solid);
+void storeLoadChunk(WorldStore *store, int x, int y, const unsigned char *page);
+bool saveWorldStore(WorldStore *store, const GameState *game);
+void closeWorldStore(WorldStore *store);
+
+#endif
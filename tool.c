@@ -0,0 +1,17 @@
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "tool.h"
+#include "global.h"
+
+// Variables
+Screen currentScreen = UNKNOWN;
+struct DebugStats debugStats = {0, 0, 0, 0};
+
+// Monotonic seconds, only meaningful as a difference
+double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,9 @@
+#ifndef TOOL_H
+#define TOOL_H
+
+// Shared by the headless tools, which link tool.c in place of main.c
+
+// Function definitions
+double now();
+
+#endif